@@ -6,72 +6,166 @@
 #include "cap_touch.h"
 #include "mode_selection.h"
 #include "leds.h"
+#include "i2c.h"
+#include "signal_capture.h"
+#include "slider_filter.h"
+#include "slider_engine.h"
+#include "slider_gesture.h"
+#include "lp_governor.h"
+#include "drift_monitor.h"
+#include "auto_tune.h"
+#include "proximity.h"
+#include "key_filter.h"
+#include "touch_history.h"
+#include "scheduler.h"
+#include "profiler.h"
+#include "latency.h"
+#include "stall_monitor.h"
 
-#include <Wire.h>
+// Scheduler stage periods, in ticks (ms)
+#define SCAN_PERIOD       1
+#define BUTTONS_PERIOD    5
+#define LEDS_PERIOD       12
+#define CONSOLE_PERIOD    2
+
+// Latest state from the scan stage, for the LED stage
+static cap_touch_state_t cs;
+static bool near;
 
 void setup_defaults() {
-  defaults_v1 defaults;
+  defaults_t defaults;
   defaults.startup_mode = 0;
   defaults.led_tracking_enabled = 1;
   defaults.midi_channel = 0;
   defaults.midi_controller = 0;
+  defaults.midi_gestures = 0;
+  slider_filter_get_config(&defaults.slider_filter);
+  lp_governor_get_config(&defaults.lp_governor);
+  cap_touch_default_topology(&defaults.topology);
+  proximity_get_config(&defaults.proximity);
+  key_filter_get_config(&defaults.key_filter);
+  drift_monitor_get_config(&defaults.drift_monitor);
 
   if (defaults_init(&defaults)) {
+    // A bad map is rejected and the default stays
+    cap_touch_set_topology(&defaults.topology);
     cap_touch_write_config(&defaults.ct);
   } 
 
+  slider_filter_set_config(&defaults.slider_filter);
+  lp_governor_set_config(&defaults.lp_governor);
+  proximity_set_config(&defaults.proximity);
+  key_filter_set_config(&defaults.key_filter);
+  drift_monitor_set_config(&defaults.drift_monitor);
+
   settings_init(&defaults);
 }
 
 void setup() {
-  Wire.begin();
+  stall_monitor_init();
+  i2c_init();
 
   indicators_init();
   buttons_init();
   leds_init();
   leds_flush();
   cap_touch_init();
+  slider_filter_init();
+  key_filter_init();
+  lp_governor_init();
+  drift_monitor_init();
 
   setup_defaults();
   
   console_init();
   mode_selection_init(settings_get_startup_mode());
 
+  scheduler_init();
+  scheduler_set_tick_handler(cap_touch_tick);
+  scheduler_set_stage(SCHEDULER_STAGE_SCAN, "scan", scan_stage, SCAN_PERIOD);
+  scheduler_set_stage(SCHEDULER_STAGE_BUTTONS, "buttons", buttons_stage, BUTTONS_PERIOD);
+  scheduler_set_stage(SCHEDULER_STAGE_LEDS, "leds", leds_stage, LEDS_PERIOD);
+  scheduler_set_stage(SCHEDULER_STAGE_CONSOLE, "console", console_stage, CONSOLE_PERIOD);
+  stall_monitor_arm();
+
   interrupts();
 }
 
 void loop() {
+  scheduler_run();
+}
+
+void buttons_stage() {
   uint8_t btn_state;
+  PROFILE_BEGIN(PROFILE_BUTTONS);
   buttons_get(&btn_state);
+  PROFILE_END(PROFILE_BUTTONS);
   
   if (btn_state & BTN_MODE) {
     mode_selection_next();
   }
 
   if (btn_state & BTN_CAL) {
-    indicators_set_ident(true);
     cap_touch_recal();
-    delay(75);
-    indicators_set_ident(false);
   }
+}
 
-  console_tick();
-  
-  cap_touch_state_t cs;
+// Takes the next touch change acquired in the background (see
+// cap_touch_tick()) through to the report
+void scan_stage() {
+  PROFILE_BEGIN(PROFILE_CAP_TOUCH);
   cap_touch_update(&cs);
+  PROFILE_END(PROFILE_CAP_TOUCH);
+  touch_history_record(TOUCH_HISTORY_READ, cs.buttons, cs.slider, cs.read_us);
+  latency_acquired(&cs);
+  near = proximity_update(&cs);
+  lp_governor_update(&cs);
+  signal_capture_tick();
+  drift_monitor_update(&cs);
+  auto_tune_tick();
+  cs.buttons = key_filter_apply(cs.buttons);
+  cs.slider = slider_engine_update(cs.slider);
+  // Recalibration holds the touch state; don't let a half-seen swipe
+  // finish against whatever comes after
+  if (cap_touch_cal_state() == CAP_TOUCH_CAL_RUNNING) {
+    slider_gesture_reset();
+  }
+  // Gestures want the unsmoothed position for speed
+  uint8_t gesture = slider_gesture_update(cs.slider, millis());
+  cs.slider = slider_filter_apply(cs.slider);
+  touch_history_record(TOUCH_HISTORY_EMIT, cs.buttons, cs.slider, micros());
+  stall_monitor_mark(STALL_MARK_EMIT);
+  PROFILE_BEGIN(PROFILE_EMIT);
   mode_selection_emit(cs.buttons, cs.slider);
-  update_tracking_leds(cs.buttons, cs.slider);
+  mode_selection_gesture(gesture);
+  PROFILE_END(PROFILE_EMIT);
+}
+
+void leds_stage() {
+  PROFILE_BEGIN(PROFILE_LEDS);
+  update_tracking_leds(cs.buttons, cs.slider, near);
+  PROFILE_END(PROFILE_LEDS);
+}
+
+void console_stage() {
+  PROFILE_BEGIN(PROFILE_CONSOLE);
+  console_tick();
+  if (auto_tune_take_save()) {
+    settings_save_defaults();
+  }
+  PROFILE_END(PROFILE_CONSOLE);
 }
 
-void update_tracking_leds(uint8_t buttons, int slider) {
+// A dim blue glow while a hand is near
+void update_tracking_leds(cap_touch_buttons_t buttons, int slider, bool near) {
   if (!settings_is_led_tracking_enabled()) {
     return;
   }
   int threshold = 0;
-  for (int i = 0; i < 8; ++i) {
-    leds_set(i, (buttons & 0x01) ? 8 : 0, (slider > threshold) ? 8 : 0, 0);
+  for (int i = 0; i < LED_COUNT; ++i) {
+    leds_set(i, (buttons & 0x01) ? 8 : 0, (slider > threshold) ? 8 : 0, near ? 2 : 0);
     buttons >>= 1;
-    threshold += 32;
+    threshold += (CAP_TOUCH_SLIDER_MAX + 1) / LED_COUNT;
   }
   leds_flush();    
 }
@@ -0,0 +1,314 @@
+#include "auto_tune.h"
+
+#include <Arduino.h>
+#include "signal_capture.h"
+
+// Candidates, cheapest acquisition first; pulse/scale is pulses in the top
+// nibble and scale in the bottom, both log2
+static const uint8_t charge_times[] = { 0, 2, 4 };
+static const uint8_t pulse_scales[] = { 0x00, 0x11, 0x21, 0x32, 0x43, 0x54 };
+
+#define CHARGE_COUNT      (sizeof(charge_times) / sizeof(charge_times[0]))
+#define PS_COUNT          (sizeof(pulse_scales) / sizeof(pulse_scales[0]))
+#define CANDIDATE_COUNT   (CHARGE_COUNT * PS_COUNT)
+
+// References this close to full scale are about to saturate
+#define REFERENCE_LIMIT   60000
+
+#define SWEEP_CALIBRATING 0
+#define SWEEP_SETTLING    1
+#define SWEEP_MEASURING   2
+
+static uint8_t state = AUTO_TUNE_IDLE;
+static cap_touch_config_t original;
+static unsigned long started_at;
+static uint32_t last_frame;
+
+// Touch and verify phases
+static int16_t touched_delta[CAP_TOUCH_PAD_COUNT];
+static uint16_t touched_ref[CAP_TOUCH_PAD_COUNT];
+static cap_touch_buttons_t touched;
+
+// Sweep phase
+static uint8_t candidate;
+static uint8_t sweep_state;
+static uint8_t frames_seen;       // also settling before verifying
+static int16_t noise_min[CAP_TOUCH_PAD_COUNT];
+static int16_t noise_max[CAP_TOUCH_PAD_COUNT];
+
+// Best candidate per pad for each charge time
+static auto_tune_result_t best[CHARGE_COUNT][CAP_TOUCH_PAD_COUNT];
+static uint8_t chosen_charge;
+static bool save_pending;
+
+static void finish(uint8_t result) {
+  if (result == AUTO_TUNE_FAILED) {
+    cap_touch_write_config(&original);
+    cap_touch_recal();
+  }
+  signal_capture_request(SIGNAL_CAPTURE_AUTO_TUNE, 0, false);
+  state = result;
+}
+
+static bool running() {
+  return state == AUTO_TUNE_TOUCH || state == AUTO_TUNE_SWEEP || state == AUTO_TUNE_VERIFY;
+}
+
+static void start_touch(uint8_t phase) {
+  memset(touched_delta, 0, sizeof(touched_delta));
+  memset(touched_ref, 0, sizeof(touched_ref));
+
+  // Pads with no key don't need touching
+  touched = 0;
+  for (int i = 0; i < CAP_TOUCH_PAD_COUNT; ++i) {
+    if (!cap_touch_pad_mapped(i)) {
+      touched |= CAP_TOUCH_PAD_BIT(i);
+    }
+  }
+  started_at = millis();
+  last_frame = signal_capture_frames();
+  state = phase;
+}
+
+void auto_tune_start() {
+  if (running()) {
+    return;
+  }
+
+  cap_touch_read_config(&original);
+  signal_capture_request(SIGNAL_CAPTURE_AUTO_TUNE, AUTO_TUNE_INTERVAL_MS, false);
+  start_touch(AUTO_TUNE_TOUCH);
+}
+
+void auto_tune_abort() {
+  if (running()) {
+    finish(AUTO_TUNE_FAILED);
+  }
+}
+
+static uint8_t pad_count(cap_touch_buttons_t mask) {
+  uint8_t n = 0;
+  for (int i = 0; i < CAP_TOUCH_PAD_COUNT; ++i) {
+    if (mask & CAP_TOUCH_PAD_BIT(i)) {
+      n++;
+    }
+  }
+  return n;
+}
+
+// A pad counts once it has been pressed firmly enough and let go again:
+// firm enough to measure, or when verifying, to reach its new threshold
+static void touch_frame() {
+  const cap_touch_raw_t *raw = signal_capture_latest();
+  for (int i = 0; i < CAP_TOUCH_PAD_COUNT; ++i) {
+    int16_t d = signal_capture_delta(i);
+    int16_t firm = (state == AUTO_TUNE_VERIFY) ? best[chosen_charge][i].threshold : AUTO_TUNE_TOUCH_MIN;
+    if (d > touched_delta[i]) {
+      touched_delta[i] = d;
+      touched_ref[i] = raw->reference[i];
+    } else if (touched_delta[i] >= firm && d < touched_delta[i] / 4) {
+      touched |= CAP_TOUCH_PAD_BIT(i);
+    }
+  }
+}
+
+static void apply_candidate() {
+  cap_touch_config_t cfg = original;
+  cfg.charge_time = charge_times[candidate / PS_COUNT];
+  for (int i = 0; i < CAP_TOUCH_PAD_COUNT; ++i) {
+    cfg.key_pulse_scale[i] = pulse_scales[candidate % PS_COUNT];
+  }
+  cap_touch_write_config(&cfg);
+  cap_touch_recal();
+  sweep_state = SWEEP_CALIBRATING;
+}
+
+static void score_candidate() {
+  const cap_touch_raw_t *raw = signal_capture_latest();
+  uint8_t charge = candidate / PS_COUNT;
+
+  for (int i = 0; i < CAP_TOUCH_PAD_COUNT; ++i) {
+    uint16_t ref = raw->reference[i];
+    if (ref >= REFERENCE_LIMIT || touched_ref[i] == 0) {
+      continue;
+    }
+
+    long predicted = (long)touched_delta[i] * ref / touched_ref[i];
+    long noise = noise_max[i] - noise_min[i];
+    if (noise < 1) {
+      noise = 1;
+    }
+    long snr = predicted * 10 / noise;
+    if (snr > 0xFFFF) {
+      snr = 0xFFFF;
+    }
+
+    auto_tune_result_t *b = &best[charge][i];
+    if (snr > b->snr_x10) {
+      long threshold = max(predicted / 2, noise * 2);
+      b->pulse_scale = pulse_scales[candidate % PS_COUNT];
+      b->threshold = constrain(threshold, 1, 255);
+      b->snr_x10 = snr;
+    }
+  }
+}
+
+static void sweep_frame() {
+  if (sweep_state == SWEEP_SETTLING) {
+    if (++frames_seen >= AUTO_TUNE_SETTLE_FRAMES) {
+      for (int i = 0; i < CAP_TOUCH_PAD_COUNT; ++i) {
+        noise_min[i] = INT16_MAX;
+        noise_max[i] = INT16_MIN;
+      }
+      frames_seen = 0;
+      sweep_state = SWEEP_MEASURING;
+    }
+    return;
+  }
+
+  for (int i = 0; i < CAP_TOUCH_PAD_COUNT; ++i) {
+    int16_t d = signal_capture_delta(i);
+    noise_min[i] = min(noise_min[i], d);
+    noise_max[i] = max(noise_max[i], d);
+  }
+  if (++frames_seen < AUTO_TUNE_NOISE_FRAMES) {
+    return;
+  }
+
+  score_candidate();
+  if (++candidate < CANDIDATE_COUNT) {
+    apply_candidate();
+  }
+}
+
+// Charge time is per controller, so it's the one that does best for the
+// worst pad
+static void apply_result() {
+  uint16_t best_worst = 0;
+  chosen_charge = 0;
+  for (uint8_t c = 0; c < CHARGE_COUNT; ++c) {
+    uint16_t worst = 0xFFFF;
+    for (int i = 0; i < CAP_TOUCH_PAD_COUNT; ++i) {
+      if (cap_touch_pad_mapped(i)) {
+        worst = min(worst, best[c][i].snr_x10);
+      }
+    }
+    if (worst > best_worst) {
+      best_worst = worst;
+      chosen_charge = c;
+    }
+  }
+
+  if (best_worst == 0) {
+    finish(AUTO_TUNE_FAILED);
+    return;
+  }
+
+  cap_touch_config_t cfg = original;
+  cfg.charge_time = charge_times[chosen_charge];
+  for (int i = 0; i < CAP_TOUCH_PAD_COUNT; ++i) {
+    cfg.key_pulse_scale[i] = best[chosen_charge][i].pulse_scale;
+    cfg.key_detect_threshold[i] = best[chosen_charge][i].threshold;
+  }
+  cap_touch_write_config(&cfg);
+  cap_touch_recal();
+  frames_seen = 0;
+  start_touch(AUTO_TUNE_VERIFY);
+}
+
+static void verify_result() {
+  for (int i = 0; i < CAP_TOUCH_PAD_COUNT; ++i) {
+    best[chosen_charge][i].delta = touched_delta[i];
+  }
+  // Hundreds of ms of EEPROM writes; not from the scan stage
+  save_pending = true;
+  finish(AUTO_TUNE_DONE);
+}
+
+void auto_tune_tick() {
+  if (!running()) {
+    return;
+  }
+
+  if (cap_touch_reset_state() != CAP_TOUCH_RESET_READY) {
+    finish(AUTO_TUNE_FAILED);
+    return;
+  }
+
+  uint32_t frames = signal_capture_frames();
+  bool new_frame = frames != last_frame;
+  last_frame = frames;
+
+  if (state == AUTO_TUNE_TOUCH) {
+    if (new_frame) {
+      touch_frame();
+    }
+    if (pad_count(touched) == CAP_TOUCH_PAD_COUNT) {
+      memset(best, 0, sizeof(best));
+      candidate = 0;
+      state = AUTO_TUNE_SWEEP;
+      apply_candidate();
+    } else if ((millis() - started_at) >= AUTO_TUNE_TOUCH_TIMEOUT_MS) {
+      finish(AUTO_TUNE_FAILED);
+    }
+    return;
+  }
+
+  if (state == AUTO_TUNE_VERIFY) {
+    // Deltas mean nothing until the new config has been calibrated, and
+    // the first frames after may have been requested before that
+    if (cap_touch_cal_state() == CAP_TOUCH_CAL_RUNNING) {
+      frames_seen = 0;
+    } else if (new_frame && ++frames_seen > AUTO_TUNE_SETTLE_FRAMES) {
+      touch_frame();
+    }
+    if (pad_count(touched) == CAP_TOUCH_PAD_COUNT) {
+      verify_result();
+    } else if ((millis() - started_at) >= AUTO_TUNE_TOUCH_TIMEOUT_MS) {
+      finish(AUTO_TUNE_FAILED);
+    }
+    return;
+  }
+
+  if (sweep_state == SWEEP_CALIBRATING) {
+    // The first frame after calibration may have been requested before it
+    if (cap_touch_cal_state() != CAP_TOUCH_CAL_RUNNING) {
+      frames_seen = 0;
+      sweep_state = SWEEP_SETTLING;
+    }
+    return;
+  }
+
+  if (new_frame) {
+    sweep_frame();
+    if (candidate == CANDIDATE_COUNT) {
+      apply_result();
+    }
+  }
+}
+
+uint8_t auto_tune_state() {
+  return state;
+}
+
+uint8_t auto_tune_progress() {
+  return (state == AUTO_TUNE_SWEEP) ? candidate : pad_count(touched);
+}
+
+uint8_t auto_tune_steps() {
+  return (state == AUTO_TUNE_SWEEP) ? CANDIDATE_COUNT : CAP_TOUCH_PAD_COUNT;
+}
+
+uint8_t auto_tune_charge_time() {
+  return charge_times[chosen_charge];
+}
+
+void auto_tune_get_result(uint8_t pad, auto_tune_result_t *out) {
+  *out = best[chosen_charge][pad];
+}
+
+bool auto_tune_take_save() {
+  bool pending = save_pending;
+  save_pending = false;
+  return pending;
+}
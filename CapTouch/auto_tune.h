@@ -0,0 +1,69 @@
+#ifndef AUTO_TUNE_H
+#define AUTO_TUNE_H
+
+#include <stdint.h>
+#include "cap_touch.h"
+
+// Auto-tune
+// ---------
+// Picks per-pad pulse/scale and detect threshold, and the charge time, for
+// the best signal-to-noise margin, then saves them as the power-on
+// defaults. Runs in the background from auto_tune_tick():
+//
+// touch: with the current config, each pad is touched once (in any order)
+//        to measure its touched delta
+// sweep: for every charge time and pulse/scale candidate, recalibrate and
+//        measure untouched noise (delta peak-to-peak) and reference level;
+//        nothing may touch the pads during this phase
+// apply: per pad, the touched delta at each candidate is predicted from
+//        the reference level (delta and reference scale together), and the
+//        candidate with the best delta/noise wins; the charge time is the
+//        one whose worst pad does best. Thresholds are set to half the
+//        predicted delta, but at least twice the noise.
+// verify: the prediction is only a prediction, so with the chosen config
+//        each pad is touched once more, and has to reach its new threshold
+//
+// Config writes and recalibration go out through the background flush, so
+// none of this holds up the scan stage. Slider keys are left alone.
+// Aborting, or failing, restores the config that was active at the start;
+// only a verified result is saved.
+
+#define AUTO_TUNE_IDLE        0
+#define AUTO_TUNE_TOUCH       1
+#define AUTO_TUNE_SWEEP       2
+#define AUTO_TUNE_VERIFY      3
+#define AUTO_TUNE_DONE        4
+#define AUTO_TUNE_FAILED      5
+
+#define AUTO_TUNE_INTERVAL_MS       20
+#define AUTO_TUNE_TOUCH_TIMEOUT_MS  60000
+#define AUTO_TUNE_TOUCH_MIN         20
+#define AUTO_TUNE_SETTLE_FRAMES     4
+#define AUTO_TUNE_NOISE_FRAMES      24
+
+typedef struct auto_tune_result {
+  uint8_t pulse_scale;
+  uint8_t threshold;
+  uint16_t snr_x10;   // predicted touched delta / noise, x10
+  int16_t delta;      // touched delta measured by the verify phase
+} auto_tune_result_t;
+
+void auto_tune_start();
+void auto_tune_abort();
+void auto_tune_tick();
+
+// True once after a successful tune; the caller saves the defaults, from
+// somewhere that can afford the EEPROM writes
+bool auto_tune_take_save();
+
+uint8_t auto_tune_state();
+
+// Progress through the current phase: pads touched (or verified), or
+// candidates measured
+uint8_t auto_tune_progress();
+uint8_t auto_tune_steps();
+
+uint8_t auto_tune_charge_time();
+void auto_tune_get_result(uint8_t pad, auto_tune_result_t *out);
+
+#endif
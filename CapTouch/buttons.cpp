@@ -1,6 +1,7 @@
 #include "buttons.h"
 
 #include <Arduino.h>
+#include "profiler.h"
 
 #define BUTTON_COUNT  2
 #define HOLD          3
@@ -31,6 +32,7 @@ void buttons_get(uint8_t *out) {
 }
 
 ISR(TIMER3_COMPA_vect) {
+  PROFILE_BEGIN(PROFILE_TIMER3_ISR);
   for (int i = 0; i < BUTTON_COUNT; ++i) {
     if (!(PINB & (1 << button_pins[i]))) {
       if (button_holds[i] < HOLD) {
@@ -42,4 +44,5 @@ ISR(TIMER3_COMPA_vect) {
       button_holds[i] = 0;
     }
   }
+  PROFILE_END(PROFILE_TIMER3_ISR);
 }
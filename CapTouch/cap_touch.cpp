@@ -1,12 +1,15 @@
 #include "cap_touch.h"
 
 #include <Arduino.h>
-#include <Wire.h>
+#include <util/atomic.h>
+#include "i2c.h"
 #include "leds.h"
+#include "touch_queue.h"
 
 // AT42QT2120
 
-#define ADDR 0x1C
+// CHANGE line: PE6/INT6, falling edge
+#define CHANGE_ASSERTED()     (!(PINE & (1 << 6)))
 
 #define REG_DETECTION_STATUS  2
 #define REG_CALIBRATE         6
@@ -22,162 +25,1120 @@
 #define REG_DTHR_BASE         16
 #define REG_KEY_CTRL_BASE     28
 #define REG_PULSE_SCALE_BASE  40
+#define REG_SIGNAL_BASE       52
+#define REG_REFERENCE_BASE    76
 #define REG_MAX               99
 
+#define KEY_COUNT             CAP_TOUCH_KEYS_PER_CONTROLLER
+
+// Setup registers 8..51 (timing, DTHR, key control, pulse/scale) are
+// contiguous so config is transferred as a single block
+#define CONFIG_BLOCK_START    REG_LP_MODE
+#define CONFIG_BLOCK_END      (REG_PULSE_SCALE_BASE + KEY_COUNT)
+#define CONFIG_BLOCK_LEN      (CONFIG_BLOCK_END - CONFIG_BLOCK_START)
+
+// Status, command and signal/reference registers are owned by the chip
+// and never cached; everything else only changes when we write it
+#define IS_VOLATILE(reg)      ((reg) < CONFIG_BLOCK_START || (reg) >= CONFIG_BLOCK_END)
+
+#define BIT_TEST(map, reg)    ((map)[(reg) >> 3] & (1 << ((reg) & 7)))
+#define BIT_SET(map, reg)     ((map)[(reg) >> 3] |= (1 << ((reg) & 7)))
+#define BIT_CLEAR(map, reg)   ((map)[(reg) >> 3] &= ~(1 << ((reg) & 7)))
+
 #define SLIDER_KEY_START      0
-#define SLIDER_KEY_COUNT      3
+#define SLIDER_KEY_COUNT      CAP_TOUCH_SLIDER_KEY_COUNT
+#define SLIDER_CONTROLLER     0
+
+// Slider options register
+#define SLIDER_ENABLE         (1 << 7)
+#define SLIDER_WHEEL          (1 << 6)
+
+// Detection status bits
+#define STATUS_TOUCH          (1 << 0)
+#define STATUS_SLIDER         (1 << 1)
+#define STATUS_CALIBRATE      (1 << 7)
+
+// Reset pulse width and time for the chip to boot afterwards
+#define RESET_PULSE_MS        2
+#define RESET_BOOT_MS         200
+
+// Consecutive failed scans before the chips are hardware reset
+#define MAX_SCAN_FAILURES     8
+
+// The chip takes a moment to raise CALIBRATE after the command is written
+#define CAL_SETTLE_MS         2
+#define CAL_POLL_MS           5
 
 #define SLIDER_DEFAULT_DTHR   10
 #define SLIDER_DEFAULT_PULSE  3
 #define SLIDER_DEFAULT_SCALE  4
 
-static uint8_t pad_to_key(uint8_t pad) {
-  return 11 - pad;
+// Chip default, for keys the topology turns back on
+#define KEY_DEFAULT_DTHR      10
+
+#define NO_SCAN               -1
+#define ALL_CONTROLLERS       ((uint8_t)((1 << CAP_TOUCH_CONTROLLER_COUNT) - 1))
+
+typedef struct controller {
+  // Detection status, key status (2 bytes) and slider position are
+  // contiguous (regs 2..5) so they're fetched in one burst
+  i2c_job_t scan_job;
+  uint8_t scan_buf[4];
+  uint8_t scan_failures;
+  cap_touch_buttons_t buttons;
+  bool proximity;
+
+  // Pad driven by each key, after the slider has claimed its keys
+  uint8_t key_pad[KEY_COUNT];
+
+  // Dirty runs are written straight out of the shadow by this job
+  i2c_job_t flush_job;
+  i2c_job_t cal_job;
+
+  // Signal and reference (regs 52..99) are read in one burst into the
+  // (otherwise unused) volatile end of the shadow. For just the slider
+  // keys, signal and reference are read separately (slider controller only).
+  i2c_job_t raw_job;
+  i2c_job_t slider_signal_job;
+  i2c_job_t slider_reference_job;
+
+  // Shadow register file. known => shadow holds the chip's value (or the
+  // value it will hold once flushed); dirty => shadow needs writing.
+  uint8_t shadow[REG_MAX + 1];
+  uint8_t known[(REG_MAX + 8) / 8];
+  uint8_t dirty[(REG_MAX + 8) / 8];
+} controller_t;
+
+static const uint8_t controller_addrs[CAP_TOUCH_CONTROLLER_COUNT] = CAP_TOUCH_ADDRESSES;
+static controller_t controllers[CAP_TOUCH_CONTROLLER_COUNT];
+
+static cap_touch_topology_t topology;
+
+// Inverse of the key maps; CAP_TOUCH_KEY_DISABLED if a pad isn't mapped
+static uint8_t pad_ctl[CAP_TOUCH_PAD_COUNT];
+static uint8_t pad_key[CAP_TOUCH_PAD_COUNT];
+
+static cap_touch_state_t current = { 0, -1, false, 0, 0 };
+static cap_touch_stats_t stats;
+static volatile bool change_pending = true;
+static volatile unsigned long change_at;  // first CHANGE since the last read
+
+static volatile int8_t scanning = NO_SCAN;  // controller with a status read in flight
+static uint8_t next_change;             // first controller to read after a CHANGE
+static uint8_t next_poll;
+#if !CAP_TOUCH_CHANGE_IRQ
+static uint8_t poll_due;                // controllers this poll hasn't read yet
+#endif
+static unsigned long last_read_at;
+static unsigned long last_poll_at;
+static uint16_t poll_interval = CAP_TOUCH_POLL_INTERVAL_MS;
+static unsigned long scan_started_at;
+static volatile unsigned long scan_done_at;
+static unsigned long scan_edge_at;
+
+// Set while the interrupts own status reads (see cap_touch_tick()); the last
+// state cap_touch_update() took from the queue
+static volatile bool acquiring;
+static cap_touch_state_t held = { 0, -1, false, 0, 0 };
+
+static uint8_t reset_state = CAP_TOUCH_RESET_ASSERTED;
+static bool reset_reflush;              // setup kept across the reset
+static unsigned long reset_started_at;
+static uint16_t first_scan_ms;
+
+static uint8_t cal_state = CAP_TOUCH_CAL_IDLE;
+static uint8_t cal_pending;             // controllers still calibrating
+static uint8_t cal_queued;              // ...whose command hasn't gone out yet
+static uint8_t cal_command = 0xFF;
+static unsigned long cal_started_at;
+static uint16_t cal_duration;
+
+static bool slider_key(uint8_t ctl, uint8_t key) {
+  return topology.slider != CAP_TOUCH_SLIDER_NONE && ctl == SLIDER_CONTROLLER &&
+         key >= SLIDER_KEY_START && key < SLIDER_KEY_START + SLIDER_KEY_COUNT;
 }
 
-static uint8_t reverse_byte(uint8_t c) {
-  uint8_t r = 0;
-  for (byte i = 0; i < 8; i++) {
-    r <<= 1;
-    r |= c & 1;
-    c >>= 1;
-  }
-	return r;
+static uint8_t addr_of(const controller_t *ct) {
+  return controller_addrs[ct - controllers];
 }
 
-static void reg_write(uint8_t reg, uint8_t val) {
-	Wire.beginTransmission(ADDR);
-	Wire.write(reg);
-	Wire.write(val);
-	Wire.endTransmission();
+static void reg_write(controller_t *ct, uint8_t reg, uint8_t val) {
+  i2c_write(addr_of(ct), reg, &val, 1);
 }
 
-static uint8_t reg_read(uint8_t reg) {
-  Wire.beginTransmission(ADDR);
-  Wire.write(reg);
-  Wire.endTransmission(false);
-  Wire.requestFrom(ADDR, 1);
-  uint8_t val;
-  Wire.readBytes(&val, 1);
+static uint8_t reg_read(controller_t *ct, uint8_t reg) {
+  uint8_t val = 0xFF;
+  i2c_read(addr_of(ct), reg, &val, 1);
   return val;
 }
 
+//
+// Shadow register file
+
+// For a chip going back to its power-on defaults. The setup block we know
+// is the setup we want, so it's kept and marked dirty to go out again once
+// the chip is up; anything else is forgotten. Returns true if any was kept.
+static bool shadow_reset(controller_t *ct) {
+  i2c_wait(&ct->flush_job);
+  ct->flush_job.status = I2C_IDLE;
+  bool kept = false;
+  for (uint8_t reg = 0; reg <= REG_MAX; ++reg) {
+    if (IS_VOLATILE(reg)) {
+      BIT_CLEAR(ct->known, reg);
+      BIT_CLEAR(ct->dirty, reg);
+    } else if (BIT_TEST(ct->known, reg)) {
+      BIT_SET(ct->dirty, reg);
+      kept = true;
+    }
+  }
+  return kept;
+}
+
+static void shadow_set(controller_t *ct, uint8_t reg, uint8_t val) {
+  if (BIT_TEST(ct->known, reg) && ct->shadow[reg] == val) {
+    return;
+  }
+  ct->shadow[reg] = val;
+  BIT_SET(ct->known, reg);
+  BIT_SET(ct->dirty, reg);
+}
+
+// Make sure every register in [start, end) is known, reading the whole range
+// in one burst if any of it isn't. Pending (dirty) values are kept.
+static void shadow_fill(controller_t *ct, uint8_t start, uint8_t end) {
+  uint8_t reg;
+  for (reg = start; reg < end; ++reg) {
+    if (!BIT_TEST(ct->known, reg)) {
+      break;
+    }
+  }
+  if (reg == end) {
+    return;
+  }
+
+  uint8_t buf[CONFIG_BLOCK_LEN];
+  if (i2c_read(addr_of(ct), start, buf, end - start) != I2C_DONE) {
+    return;
+  }
+  for (reg = start; reg < end; ++reg) {
+    if (!BIT_TEST(ct->dirty, reg)) {
+      ct->shadow[reg] = buf[reg - start];
+      BIT_SET(ct->known, reg);
+    }
+  }
+}
+
+// Find the next run of dirty registers. Clean registers between dirty ones
+// are written too (their shadow values are current) so the run goes out as
+// a single burst; only an unknown register splits it.
+static bool next_dirty_run(const controller_t *ct, uint8_t *start, uint8_t *len) {
+  int first = -1, last = -1;
+  for (uint8_t reg = CONFIG_BLOCK_START; reg < CONFIG_BLOCK_END; ++reg) {
+    if (BIT_TEST(ct->dirty, reg)) {
+      if (first < 0) {
+        first = reg;
+      }
+      last = reg;
+    } else if (first >= 0 && !BIT_TEST(ct->known, reg)) {
+      break;
+    }
+  }
+  if (first < 0) {
+    return false;
+  }
+  *start = first;
+  *len = last - first + 1;
+  return true;
+}
+
+static void mark_run(controller_t *ct, uint8_t start, uint8_t len, bool is_dirty) {
+  for (uint8_t reg = start; reg < start + len; ++reg) {
+    if (is_dirty) {
+      BIT_SET(ct->dirty, reg);
+    } else {
+      BIT_CLEAR(ct->dirty, reg);
+    }
+  }
+}
+
+// Start writing the next dirty run in the background. The dirty bits are
+// cleared up front; a register modified while the write is in flight is
+// simply marked dirty again and goes out with the next flush.
+static void flush_step(controller_t *ct) {
+  i2c_job_t *job = &ct->flush_job;
+  if (reset_state < CAP_TOUCH_RESET_CALIBRATING || I2C_PENDING(job)) {
+    return;
+  }
+  if (job->status != I2C_IDLE && job->status != I2C_DONE) {
+    mark_run(ct, job->reg, job->len, true);
+  }
+  job->status = I2C_IDLE;
+
+  uint8_t start, len;
+  if (!next_dirty_run(ct, &start, &len)) {
+    return;
+  }
+  mark_run(ct, start, len, false);
+  job->reg = start;
+  job->len = len;
+  job->buf = &ct->shadow[start];
+  if (i2c_submit(job)) {
+    stats.flush_bursts++;
+  } else {
+    mark_run(ct, start, len, true);
+  }
+}
+
+// Blocking flush of everything pending. Gives up on a bus error; the
+// failed run stays dirty and is retried by the next flush.
+static void flush_all(controller_t *ct) {
+  do {
+    flush_step(ct);
+  } while (i2c_wait(&ct->flush_job) == I2C_DONE);
+}
+
+//
+// Status scanning
+
+static bool scan_complete(uint8_t ix);
+static int8_t scan_target();
+static void start_scan(int8_t target);
+
+// Called from the TWI interrupt
+static void scan_done(i2c_job_t *job) {
+  scan_done_at = micros();
+#if CAP_TOUCH_CHANGE_IRQ
+  // Reading the status deasserts this controller's CHANGE; if the line is
+  // still low the chip has already latched another change, or another
+  // controller has something to report
+  if (CHANGE_ASSERTED()) {
+    change_at = scan_done_at;
+    change_pending = true;
+  }
+#endif
+
+  if (!acquiring) {
+    return;
+  }
+  // Failures can end in a reset; leave them for cap_touch_update()
+  if (job->status != I2C_DONE) {
+    acquiring = false;
+    return;
+  }
+  uint8_t ix = scanning;
+  scanning = NO_SCAN;
+  scan_complete(ix);
+  touch_queue_put(&current);
+
+  // The rest of a poll, or the next controller with CHANGE still asserted,
+  // straight after rather than a tick later
+  int8_t target = scan_target();
+  if (target != NO_SCAN) {
+    start_scan(target);
+  }
+}
+
+static void decode_status(uint8_t ix) {
+  controller_t *ct = &controllers[ix];
+  const uint8_t *buf = ct->scan_buf;
+
+  if (ix == SLIDER_CONTROLLER && topology.slider != CAP_TOUCH_SLIDER_NONE) {
+    if (buf[0] & STATUS_SLIDER) {
+      current.slider = ((long)(255 - buf[3]) * CAP_TOUCH_SLIDER_MAX) / 255;
+    } else {
+      current.slider = -1;
+    }
+  }
+
+  uint16_t keys = buf[1] | (buf[2] << 8);
+  cap_touch_buttons_t buttons = 0;
+  bool proximity = false;
+  for (uint8_t k = 0; k < KEY_COUNT; ++k, keys >>= 1) {
+    if (!(keys & 1)) {
+      continue;
+    }
+    uint8_t pad = ct->key_pad[k];
+    if (pad == CAP_TOUCH_KEY_PROXIMITY) {
+      proximity = true;
+    } else if (pad != CAP_TOUCH_KEY_DISABLED) {
+      buttons |= CAP_TOUCH_PAD_BIT(pad);
+    }
+  }
+  ct->buttons = buttons;
+  ct->proximity = proximity;
+
+  buttons = 0;
+  proximity = false;
+  for (uint8_t i = 0; i < CAP_TOUCH_CONTROLLER_COUNT; ++i) {
+    buttons |= controllers[i].buttons;
+    proximity |= controllers[i].proximity;
+  }
+  current.buttons = buttons;
+  current.proximity = proximity;
+  current.read_us = scan_done_at;
+  current.edge_us = scan_edge_at;
+}
+
+static uint8_t take_next_poll() {
+  uint8_t ix = next_poll;
+  next_poll = (next_poll + 1) % CAP_TOUCH_CONTROLLER_COUNT;
+  return ix;
+}
+
+// Picks the controller to read next, or NO_SCAN if nothing is due
+static int8_t scan_target() {
+  if (cal_state == CAP_TOUCH_CAL_RUNNING) {
+    if ((millis() - last_read_at) < CAL_POLL_MS) {
+      return NO_SCAN;
+    }
+    // Only the controllers that haven't finished yet
+    for (uint8_t i = 0; i < CAP_TOUCH_CONTROLLER_COUNT; ++i) {
+      uint8_t ix = take_next_poll();
+      if (cal_pending & (1 << ix)) {
+        return ix;
+      }
+    }
+    return NO_SCAN;
+  }
+
+  // Without the interrupt only retries and fresh readings after calibration
+  // set this
+  if (change_pending) {
+    return next_change;
+  }
+#if CAP_TOUCH_CHANGE_IRQ
+  if ((millis() - last_poll_at) >= (poll_interval / CAP_TOUCH_CONTROLLER_COUNT)) {
+    last_poll_at = millis();
+    stats.reads_polled++;
+    return take_next_poll();
+  }
+#else
+  // Nothing says which controller has news, so each poll reads them all
+  if (!poll_due && (millis() - last_poll_at) >= poll_interval) {
+    last_poll_at = millis();
+    poll_due = ALL_CONTROLLERS;
+  }
+  for (uint8_t i = 0; i < CAP_TOUCH_CONTROLLER_COUNT; ++i) {
+    if (poll_due & (1 << i)) {
+      poll_due &= ~(1 << i);
+      stats.reads_polled++;
+      return i;
+    }
+  }
+#endif
+  return NO_SCAN;
+}
+
+// Starts a status read of target, if there is one
+static void start_scan(int8_t target) {
+  if (target == NO_SCAN) {
+    stats.reads_skipped++;
+    return;
+  }
+  // Clear before starting so an edge that arrives mid-read isn't lost
+  unsigned long now_us = micros();
+#if CAP_TOUCH_CHANGE_IRQ
+  scan_edge_at = change_pending ? change_at : now_us;
+#else
+  scan_edge_at = now_us;
+#endif
+  change_pending = false;
+  last_read_at = millis();
+  scan_started_at = now_us;
+  if (i2c_submit(&controllers[target].scan_job)) {
+    scanning = target;
+    stats.reads++;
+  } else {
+    change_pending = true;
+  }
+}
+
+static void job_init(i2c_job_t *job, uint8_t addr, uint8_t reg, uint8_t dir, uint8_t len, uint8_t *buf, void (*done)(i2c_job_t*)) {
+  job->addr = addr;
+  job->reg = reg;
+  job->dir = dir;
+  job->len = len;
+  job->buf = buf;
+  job->done = done;
+  job->status = I2C_IDLE;
+}
+
+//
+// Topology
+
+// Rebuilds the effective key maps and their inverse from the topology
+static void build_key_maps() {
+  memset(pad_ctl, CAP_TOUCH_KEY_DISABLED, sizeof(pad_ctl));
+  memset(pad_key, CAP_TOUCH_KEY_DISABLED, sizeof(pad_key));
+
+  for (uint8_t c = 0; c < CAP_TOUCH_CONTROLLER_COUNT; ++c) {
+    for (uint8_t k = 0; k < KEY_COUNT; ++k) {
+      uint8_t pad = topology.key_pad[c][k];
+      if (slider_key(c, k)) {
+        pad = CAP_TOUCH_KEY_DISABLED;
+      }
+      controllers[c].key_pad[k] = pad;
+      if (pad < CAP_TOUCH_PAD_COUNT) {
+        pad_ctl[pad] = c;
+        pad_key[pad] = k;
+      }
+    }
+  }
+}
+
+// Switches unused keys off and sets the slider mode. A key coming back into
+// use gets the chip's default threshold if it was off; proximity keys are
+// left to cap_touch_set_proximity().
+static void topology_to_shadow() {
+  for (uint8_t c = 0; c < CAP_TOUCH_CONTROLLER_COUNT; ++c) {
+    controller_t *ct = &controllers[c];
+    for (uint8_t k = 0; k < KEY_COUNT; ++k) {
+      uint8_t reg = REG_DTHR_BASE + k;
+      if (ct->key_pad[k] == CAP_TOUCH_KEY_PROXIMITY) {
+        continue;
+      }
+      if (ct->key_pad[k] == CAP_TOUCH_KEY_DISABLED && !slider_key(c, k)) {
+        shadow_set(ct, reg, 0);
+      } else if (BIT_TEST(ct->known, reg) && ct->shadow[reg] == 0) {
+        shadow_set(ct, reg, slider_key(c, k) ? SLIDER_DEFAULT_DTHR : KEY_DEFAULT_DTHR);
+      }
+    }
+  }
+
+  controller_t *ct = &controllers[SLIDER_CONTROLLER];
+  uint8_t options = BIT_TEST(ct->known, REG_SLIDER) ? (ct->shadow[REG_SLIDER] & ~(SLIDER_ENABLE | SLIDER_WHEEL)) : 0;
+  if (topology.slider == CAP_TOUCH_SLIDER_LINEAR) {
+    options |= SLIDER_ENABLE;
+  } else if (topology.slider == CAP_TOUCH_SLIDER_WHEEL) {
+    options |= SLIDER_ENABLE | SLIDER_WHEEL;
+  }
+  shadow_set(ct, REG_SLIDER, options);
+}
+
 void cap_touch_init() {
 	// Setup hardware reset pin
   PORTD |= (1 << 4);
 	DDRD |= (1 << 4);
+
+  for (uint8_t i = 0; i < CAP_TOUCH_CONTROLLER_COUNT; ++i) {
+    controller_t *ct = &controllers[i];
+    uint8_t addr = controller_addrs[i];
+    job_init(&ct->scan_job, addr, REG_DETECTION_STATUS, I2C_READ, sizeof(ct->scan_buf), ct->scan_buf, scan_done);
+    job_init(&ct->flush_job, addr, 0, I2C_WRITE, 0, NULL, NULL);
+    job_init(&ct->cal_job, addr, REG_CALIBRATE, I2C_WRITE, 1, &cal_command, NULL);
+    job_init(&ct->raw_job, addr, REG_SIGNAL_BASE, I2C_READ, REG_MAX + 1 - REG_SIGNAL_BASE, &ct->shadow[REG_SIGNAL_BASE], NULL);
+  }
+  controller_t *sct = &controllers[SLIDER_CONTROLLER];
+  uint8_t sig = REG_SIGNAL_BASE + SLIDER_KEY_START * 2;
+  uint8_t ref = REG_REFERENCE_BASE + SLIDER_KEY_START * 2;
+  job_init(&sct->slider_signal_job, controller_addrs[SLIDER_CONTROLLER], sig, I2C_READ, SLIDER_KEY_COUNT * 2, &sct->shadow[sig], NULL);
+  job_init(&sct->slider_reference_job, controller_addrs[SLIDER_CONTROLLER], ref, I2C_READ, SLIDER_KEY_COUNT * 2, &sct->shadow[ref], NULL);
+
+#if CAP_TOUCH_CHANGE_IRQ
+  // CHANGE is open drain; input with pull-up, interrupt on falling edge
+  DDRE &= ~(1 << 6);
+  PORTE |= (1 << 6);
+  EICRB = (EICRB & ~((1 << ISC61) | (1 << ISC60))) | (1 << ISC61);
+  EIFR = (1 << INTF6);
+  EIMSK |= (1 << INT6);
+#endif
 	
+  cap_touch_default_topology(&topology);
+  build_key_maps();
   cap_touch_reset();
 }
 
+// Starts a hardware reset and returns immediately. cap_touch_update() runs
+// the rest of the sequence (release, boot wait, recalibration); config
+// written before or during the reset is held in the shadow and flushed once
+// the chips are up. The last touch state is held throughout.
 void cap_touch_reset() {
+  acquiring = false;
+
+  // Chips are going back to their defaults; what we'd set goes out again
+  reset_reflush = false;
+  for (uint8_t i = 0; i < CAP_TOUCH_CONTROLLER_COUNT; ++i) {
+    reset_reflush |= shadow_reset(&controllers[i]);
+  }
+
+  controller_t *ct = &controllers[SLIDER_CONTROLLER];
+
+  // Write slider defaults, unless the slider's already been set up
+  if (topology.slider != CAP_TOUCH_SLIDER_NONE) {
+    for (int i = 0; i < SLIDER_KEY_COUNT; ++i) {
+      uint8_t dthr = REG_DTHR_BASE + SLIDER_KEY_START + i;
+      uint8_t pulse_scale = REG_PULSE_SCALE_BASE + SLIDER_KEY_START + i;
+      if (!BIT_TEST(ct->known, dthr)) {
+        shadow_set(ct, dthr, SLIDER_DEFAULT_DTHR);
+      }
+      if (!BIT_TEST(ct->known, pulse_scale)) {
+        shadow_set(ct, pulse_scale, (SLIDER_DEFAULT_PULSE << 4) | SLIDER_DEFAULT_SCALE);
+      }
+    }
+  }
+  topology_to_shadow();
+
   PORTD &= ~(1 << 4);
-  delay(2);
-  PORTD |= (1 << 4);
-  delay(200);
+  reset_state = CAP_TOUCH_RESET_ASSERTED;
+  reset_started_at = millis();
+}
+
+static void reset_step() {
+  unsigned long elapsed = millis() - reset_started_at;
+  switch (reset_state) {
+    case CAP_TOUCH_RESET_ASSERTED:
+      if (elapsed >= RESET_PULSE_MS) {
+        PORTD |= (1 << 4);
+        reset_state = CAP_TOUCH_RESET_BOOTING;
+      }
+      break;
+    case CAP_TOUCH_RESET_BOOTING:
+      if (elapsed >= RESET_PULSE_MS + RESET_BOOT_MS) {
+        reset_state = CAP_TOUCH_RESET_CALIBRATING;
+        // Flushes the kept setup before calibrating against it
+        cap_touch_recal();
+        if (reset_reflush) {
+          reset_reflush = false;
+          stats.config_reflushes++;
+        }
+      }
+      break;
+  }
+}
+
+uint8_t cap_touch_reset_state() {
+  return reset_state;
+}
+
+uint16_t cap_touch_first_scan_time() {
+  return (reset_state == CAP_TOUCH_RESET_READY) ? first_scan_ms : (millis() - reset_started_at);
+}
 
-  // reg_write(REG_RESET, 0xFF);
-  // delay(200);
+static void cal_finish(uint8_t state) {
+  cal_state = state;
+  cal_pending = 0;
+  cal_queued = 0;
+  cal_duration = millis() - cal_started_at;
+  indicators_set_ident(false);
 
-  // Enable slider, no wheel
-  reg_write(REG_SLIDER, 0x80);
+  // Touch state was held while calibrating; take a fresh reading
+  change_pending = true;
+}
 
-  // Write slider defaults
-  for (int i = 0; i < SLIDER_KEY_COUNT; ++i) {
-    reg_write(REG_DTHR_BASE + SLIDER_KEY_START + i, SLIDER_DEFAULT_DTHR);
-    reg_write(REG_PULSE_SCALE_BASE + SLIDER_KEY_START + i, (SLIDER_DEFAULT_PULSE << 4) | SLIDER_DEFAULT_SCALE);
+// Called for every scan completed while calibrating. Scans started before
+// the command settled can't be trusted to show the CALIBRATE flag.
+static void cal_check(uint8_t ix, uint8_t detection_status) {
+  if (cal_queued & (1 << ix)) {
+    return;
+  }
+  if ((long)(last_read_at - cal_started_at) >= CAL_SETTLE_MS && !(detection_status & STATUS_CALIBRATE)) {
+    cal_pending &= ~(1 << ix);
+    if (!cal_pending) {
+      cal_finish(CAP_TOUCH_CAL_IDLE);
+    }
   }
+}
+
+// Calibrate against the config we've asked for, not a half-written one: a
+// controller's command goes out once it has nothing left to flush. Scans
+// queued behind it are the first that count (see cal_check()).
+static void cal_step() {
+  if (reset_state < CAP_TOUCH_RESET_CALIBRATING) {
+    return;
+  }
+  for (uint8_t i = 0; i < CAP_TOUCH_CONTROLLER_COUNT; ++i) {
+    controller_t *ct = &controllers[i];
+    uint8_t start, len;
+    if (!(cal_queued & (1 << i)) || I2C_PENDING(&ct->flush_job) || next_dirty_run(ct, &start, &len)) {
+      continue;
+    }
+    if (i2c_submit(&ct->cal_job)) {
+      cal_queued &= ~(1 << i);
+      cal_started_at = millis();
+    }
+  }
+}
 
-  // Recalibrate
-  cap_touch_recal(); 
+// Config writes queue behind any status read in flight. Waiting for a gap
+// between reads would starve them: the tick starts one just before each
+// update.
+static void flush_config() {
+  for (uint8_t i = 0; i < CAP_TOUCH_CONTROLLER_COUNT; ++i) {
+    flush_step(&controllers[i]);
+  }
+  cal_step();
 }
 
+// Starts calibration and returns immediately, without waiting on the bus;
+// cap_touch_update() flushes the config, sends the command and polls for
+// completion, holding the last touch state until it's done
 void cap_touch_recal() {
-  reg_write(REG_CALIBRATE, 0xFF);
-  delay(2);
-  while (reg_read(REG_DETECTION_STATUS) & 0x80) {
-    /* spin */
+  cap_touch_recal_controllers(ALL_CONTROLLERS);
+}
+
+// The QT2120 can only calibrate all of its keys at once, so the finest
+// target is a controller
+void cap_touch_recal_controllers(uint8_t mask) {
+  mask &= ALL_CONTROLLERS;
+
+  // The reset sequence calibrates once the chips have booted
+  if (reset_state < CAP_TOUCH_RESET_CALIBRATING || !mask) {
+    return;
+  }
+  acquiring = false;
+
+  cal_state = CAP_TOUCH_CAL_RUNNING;
+  cal_pending |= mask;
+  cal_queued |= mask;
+  cal_started_at = millis();
+  indicators_set_ident(true);
+  flush_config();
+}
+
+uint8_t cap_touch_cal_state() {
+  return cal_state;
+}
+
+uint16_t cap_touch_cal_duration() {
+  return (cal_state == CAP_TOUCH_CAL_RUNNING) ? (millis() - cal_started_at) : cal_duration;
+}
+
+// Handles a finished status read. Returns false if it led to a reset.
+static bool scan_complete(uint8_t ix) {
+  controller_t *ct = &controllers[ix];
+  uint8_t status = ct->scan_job.status;
+  ct->scan_job.status = I2C_IDLE;
+
+  if (status == I2C_DONE) {
+    if (cal_state == CAP_TOUCH_CAL_RUNNING) {
+      cal_check(ix, ct->scan_buf[0]);
+    } else {
+      decode_status(ix);
+      if (reset_state == CAP_TOUCH_RESET_CALIBRATING) {
+        reset_state = CAP_TOUCH_RESET_READY;
+        first_scan_ms = millis() - reset_started_at;
+      }
+    }
+    stats.last_read_us = scan_done_at - scan_started_at;
+    stats.total_read_us += stats.last_read_us;
+    if (stats.last_read_us > stats.max_read_us) {
+      stats.max_read_us = stats.last_read_us;
+    }
+    ct->scan_failures = 0;
+
+    // CHANGE still asserted means another controller has news; otherwise
+    // this one was the active one, so it's read first next time
+    next_change = change_pending ? (ix + 1) % CAP_TOUCH_CONTROLLER_COUNT : ix;
+    return true;
+  }
+
+  // Failed; retry on this update, or if the chip has stopped responding
+  // altogether reset them all (the i2c driver has already cleared the bus)
+  change_pending = true;
+  next_change = ix;
+  if (++ct->scan_failures >= MAX_SCAN_FAILURES) {
+    ct->scan_failures = 0;
+    stats.hw_resets++;
+    cap_touch_reset();
+    return false;
+  }
+  return true;
+}
+
+// Once the chips are up and calibrated, status reads are started from the
+// scheduler's timer interrupt and decoded as they complete (scan_done()),
+// so acquisition keeps time however long the main loop is held up.
+// Reset, calibration, topology changes and read failures take them back
+// to cap_touch_update().
+void cap_touch_tick() {
+  if (acquiring && scanning == NO_SCAN) {
+    start_scan(scan_target());
   }
 }
 
+// Non-blocking. While the interrupts are reading status, *state receives
+// the next change they've queued, or the last one again if there's none.
+// Otherwise it collects the result of the previous scan (if it has
+// completed) and starts the next one when due, and *state receives the
+// most recent decoded state.
 void cap_touch_update(cap_touch_state_t *state) {
-	byte buf[3];
-
-	Wire.beginTransmission(ADDR);
-	Wire.write(2);
-	Wire.endTransmission(false);
-	Wire.requestFrom(ADDR, 3);
-	Wire.readBytes(buf, 3);
-	if (buf[0] & (1 << 1)) {
-  	Wire.beginTransmission(ADDR);
-  	Wire.write(5);
-  	Wire.endTransmission(false);
-  	Wire.requestFrom(0x1C, 1);
-	  uint8_t sv;
-  	Wire.readBytes(&sv, 1);
-  	state->slider = 255 - sv;
-	} else {
-		state->slider = -1;
-	}
-
-	state->buttons = (buf[1] >> 4) | (buf[2] << 4);
-	state->buttons = reverse_byte(state->buttons);
-}
-
-uint8_t cap_touch_read_reg(uint8_t reg) {
-  if (reg > REG_MAX) {
+  stats.updates++;
+
+  // Keeps transaction time bounded even when nobody is blocked on the bus
+  i2c_poll();
+
+  if (acquiring) {
+    touch_queue_get(&held);
+    flush_config();
+    *state = held;
+    return;
+  }
+
+  bool scan_finished = scanning != NO_SCAN && !I2C_PENDING(&controllers[scanning].scan_job);
+
+  if (reset_state < CAP_TOUCH_RESET_CALIBRATING) {
+    reset_step();
+    // Anything read before the reset is stale
+    if (scan_finished) {
+      controllers[scanning].scan_job.status = I2C_IDLE;
+      scanning = NO_SCAN;
+    }
+    *state = current;
+    return;
+  }
+
+  if (scan_finished) {
+    uint8_t ix = scanning;
+    scanning = NO_SCAN;
+    if (!scan_complete(ix)) {
+      *state = current;
+      return;
+    }
+  }
+
+  if (cal_state == CAP_TOUCH_CAL_RUNNING && (millis() - cal_started_at) >= CAP_TOUCH_CAL_TIMEOUT_MS) {
+    stats.cal_timeouts++;
+    cal_finish(CAP_TOUCH_CAL_TIMEOUT);
+  }
+
+  if (reset_state == CAP_TOUCH_RESET_READY && cal_state != CAP_TOUCH_CAL_RUNNING && scanning == NO_SCAN) {
+    // Hand status reads over to the interrupts
+    touch_queue_clear(&current);
+    held = current;
+    acquiring = true;
+  } else {
+    start_scan((scanning == NO_SCAN) ? scan_target() : NO_SCAN);
+  }
+
+  flush_config();
+  *state = current;
+}
+
+uint8_t cap_touch_read_reg(uint8_t ctl, uint8_t reg) {
+  if (ctl >= CAP_TOUCH_CONTROLLER_COUNT || reg > REG_MAX) {
     return 0xFF;
   }
-  return reg_read(reg);
+  controller_t *ct = &controllers[ctl];
+  if (IS_VOLATILE(reg)) {
+    return reg_read(ct, reg);
+  }
+  shadow_fill(ct, reg, reg + 1);
+  return ct->shadow[reg];
 }
 
-void cap_touch_write_reg(uint8_t reg, uint8_t val) {
-  if (reg > REG_MAX) {
+void cap_touch_write_reg(uint8_t ctl, uint8_t reg, uint8_t val) {
+  if (ctl >= CAP_TOUCH_CONTROLLER_COUNT || reg > REG_MAX) {
     return;
   }
-  reg_write(reg, val);
+  controller_t *ct = &controllers[ctl];
+  if (IS_VOLATILE(reg)) {
+    // Commands (calibrate, reset) must see any config written before them
+    flush_all(ct);
+    reg_write(ct, reg, val);
+  } else {
+    shadow_set(ct, reg, val);
+  }
 }
 
-void cap_touch_read_config(cap_touch_config_t *out) {
-  out->lp_mode = reg_read(REG_LP_MODE);
-  out->ttd = reg_read(REG_TTD);
-  out->atd = reg_read(REG_ATD);
-  out->detection_integrator = reg_read(REG_DI);
-  out->touch_recal_delay = reg_read(REG_TRD);
-  out->drift_hold_time = reg_read(REG_DHT);
-  out->charge_time = reg_read(REG_CHARGE_TIME);
-  out->slider = reg_read(REG_SLIDER);
-  
-  out->slider_detect_threshold = reg_read(REG_DTHR_BASE + SLIDER_KEY_START);
-  out->slider_pulse_scale = reg_read(REG_PULSE_SCALE_BASE + SLIDER_KEY_START);
+// Global settings are read back from the slider controller; the others
+// hold the same values
+static void shadow_to_config(cap_touch_config_t *out) {
+  const uint8_t *shadow = controllers[SLIDER_CONTROLLER].shadow;
+
+  out->lp_mode = shadow[REG_LP_MODE];
+  out->ttd = shadow[REG_TTD];
+  out->atd = shadow[REG_ATD];
+  out->detection_integrator = shadow[REG_DI];
+  out->touch_recal_delay = shadow[REG_TRD];
+  out->drift_hold_time = shadow[REG_DHT];
+  out->charge_time = shadow[REG_CHARGE_TIME];
+  out->slider = shadow[REG_SLIDER];
+
+  out->slider_detect_threshold = shadow[REG_DTHR_BASE + SLIDER_KEY_START];
+  out->slider_pulse_scale = shadow[REG_PULSE_SCALE_BASE + SLIDER_KEY_START];
 
   for (int i = 0; i < CAP_TOUCH_PAD_COUNT; ++i) {
-    uint8_t key = pad_to_key(i);
-    out->key_detect_threshold[i] = reg_read(REG_DTHR_BASE + key);
-    out->key_control[i] = reg_read(REG_KEY_CTRL_BASE + key);
-    out->key_pulse_scale[i] = reg_read(REG_PULSE_SCALE_BASE + key);
+    if (pad_ctl[i] == CAP_TOUCH_KEY_DISABLED) {
+      out->key_detect_threshold[i] = 0;
+      out->key_control[i] = 0;
+      out->key_pulse_scale[i] = 0;
+      continue;
+    }
+    const controller_t *ct = &controllers[pad_ctl[i]];
+    uint8_t key = pad_key[i];
+    out->key_detect_threshold[i] = ct->shadow[REG_DTHR_BASE + key];
+    out->key_control[i] = ct->shadow[REG_KEY_CTRL_BASE + key];
+    out->key_pulse_scale[i] = ct->shadow[REG_PULSE_SCALE_BASE + key];
   }
 }
 
-void cap_touch_write_config(cap_touch_config_t *in) {
-  reg_write(REG_LP_MODE, in->lp_mode);
-  reg_write(REG_TTD, in->ttd);
-  reg_write(REG_ATD, in->atd);
-  reg_write(REG_DI, in->detection_integrator);
-  reg_write(REG_TRD, in->touch_recal_delay);
-  reg_write(REG_DHT, in->drift_hold_time);
-  reg_write(REG_CHARGE_TIME, in->charge_time);
-  reg_write(REG_SLIDER, in->slider);
-
-  for (int i = 0; i < SLIDER_KEY_COUNT; ++i) {
-    reg_write(REG_DTHR_BASE + SLIDER_KEY_START + i, in->slider_detect_threshold);
-    reg_write(REG_PULSE_SCALE_BASE + SLIDER_KEY_START + i, in->slider_pulse_scale);
-  }
-  
+// Global settings go to every controller, slider settings to the slider
+// controller only. Settings for unmapped pads are ignored, and the topology
+// has the last word on which keys are enabled and the slider mode.
+static void config_to_shadow(const cap_touch_config_t *in) {
+  for (uint8_t i = 0; i < CAP_TOUCH_CONTROLLER_COUNT; ++i) {
+    controller_t *ct = &controllers[i];
+    shadow_set(ct, REG_LP_MODE, in->lp_mode);
+    shadow_set(ct, REG_TTD, in->ttd);
+    shadow_set(ct, REG_ATD, in->atd);
+    shadow_set(ct, REG_DI, in->detection_integrator);
+    shadow_set(ct, REG_TRD, in->touch_recal_delay);
+    shadow_set(ct, REG_DHT, in->drift_hold_time);
+    shadow_set(ct, REG_CHARGE_TIME, in->charge_time);
+  }
+
+  controller_t *slider = &controllers[SLIDER_CONTROLLER];
+  shadow_set(slider, REG_SLIDER, in->slider);
+  if (topology.slider != CAP_TOUCH_SLIDER_NONE) {
+    for (int i = 0; i < SLIDER_KEY_COUNT; ++i) {
+      shadow_set(slider, REG_DTHR_BASE + SLIDER_KEY_START + i, in->slider_detect_threshold);
+      shadow_set(slider, REG_PULSE_SCALE_BASE + SLIDER_KEY_START + i, in->slider_pulse_scale);
+    }
+  }
+
   for (int i = 0; i < CAP_TOUCH_PAD_COUNT; ++i) {
-    uint8_t key = pad_to_key(i);
-    reg_write(REG_DTHR_BASE + key, in->key_detect_threshold[i]);
-    reg_write(REG_KEY_CTRL_BASE + key, in->key_control[i]);
-    reg_write(REG_PULSE_SCALE_BASE + key, in->key_pulse_scale[i]);
+    if (pad_ctl[i] == CAP_TOUCH_KEY_DISABLED) {
+      continue;
+    }
+    controller_t *ct = &controllers[pad_ctl[i]];
+    uint8_t key = pad_key[i];
+    shadow_set(ct, REG_DTHR_BASE + key, in->key_detect_threshold[i]);
+    shadow_set(ct, REG_KEY_CTRL_BASE + key, in->key_control[i]);
+    shadow_set(ct, REG_PULSE_SCALE_BASE + key, in->key_pulse_scale[i]);
+  }
+
+  topology_to_shadow();
+}
+
+void cap_touch_default_topology(cap_touch_topology_t *out) {
+  out->slider = CAP_TOUCH_SLIDER_LINEAR;
+  for (uint8_t c = 0; c < CAP_TOUCH_CONTROLLER_COUNT; ++c) {
+    for (uint8_t k = 0; k < KEY_COUNT; ++k) {
+      out->key_pad[c][k] = (k >= 4) ? c * 8 + (KEY_COUNT - 1 - k) : CAP_TOUCH_KEY_DISABLED;
+    }
+  }
+}
+
+void cap_touch_get_topology(cap_touch_topology_t *out) {
+  *out = topology;
+}
+
+// Rejects out of range pads and pads mapped to more than one key. Once the
+// chips are up the current config is carried over to the new map, so pads
+// keep their settings wherever they've moved to, and they're recalibrated.
+bool cap_touch_set_topology(const cap_touch_topology_t *in) {
+  if (in->slider > CAP_TOUCH_SLIDER_WHEEL) {
+    return false;
+  }
+  cap_touch_buttons_t seen = 0;
+  for (uint8_t c = 0; c < CAP_TOUCH_CONTROLLER_COUNT; ++c) {
+    for (uint8_t k = 0; k < KEY_COUNT; ++k) {
+      uint8_t pad = in->key_pad[c][k];
+      if (pad == CAP_TOUCH_KEY_DISABLED || pad == CAP_TOUCH_KEY_PROXIMITY || (in->slider != CAP_TOUCH_SLIDER_NONE && c == SLIDER_CONTROLLER &&
+                                            k >= SLIDER_KEY_START && k < SLIDER_KEY_START + SLIDER_KEY_COUNT)) {
+        continue;
+      }
+      if (pad >= CAP_TOUCH_PAD_COUNT || (seen & CAP_TOUCH_PAD_BIT(pad))) {
+        return false;
+      }
+      seen |= CAP_TOUCH_PAD_BIT(pad);
+    }
+  }
+
+  bool ready = reset_state == CAP_TOUCH_RESET_READY;
+  cap_touch_config_t config;
+  if (ready) {
+    cap_touch_read_config(&config);
+  }
+
+  // Not with the interrupts decoding against the old maps
+  acquiring = false;
+  topology = *in;
+  build_key_maps();
+  current.buttons = 0;
+  current.proximity = false;
+  for (uint8_t i = 0; i < CAP_TOUCH_CONTROLLER_COUNT; ++i) {
+    controllers[i].buttons = 0;
+    controllers[i].proximity = false;
+  }
+  if (topology.slider == CAP_TOUCH_SLIDER_NONE) {
+    current.slider = -1;
+  }
+
+  if (ready) {
+    config_to_shadow(&config);
+    cap_touch_recal();
+  } else {
+    topology_to_shadow();
+  }
+  return true;
+}
+
+// Applies to every key with the proximity role. Like the LP mode, cheap to
+// call repeatedly: only a change reaches the bus.
+void cap_touch_set_proximity(uint8_t detect_threshold, uint8_t pulse_scale) {
+  for (uint8_t c = 0; c < CAP_TOUCH_CONTROLLER_COUNT; ++c) {
+    controller_t *ct = &controllers[c];
+    for (uint8_t k = 0; k < KEY_COUNT; ++k) {
+      if (ct->key_pad[k] == CAP_TOUCH_KEY_PROXIMITY) {
+        shadow_set(ct, REG_DTHR_BASE + k, detect_threshold);
+        shadow_set(ct, REG_PULSE_SCALE_BASE + k, pulse_scale);
+      }
+    }
+  }
+}
+
+uint8_t cap_touch_slider_mode() {
+  return topology.slider;
+}
+
+bool cap_touch_pad_mapped(uint8_t pad) {
+  return pad < CAP_TOUCH_PAD_COUNT && pad_ctl[pad] != CAP_TOUCH_KEY_DISABLED;
+}
+
+// Controller a pad's key is on, CAP_TOUCH_KEY_DISABLED if it has none
+uint8_t cap_touch_pad_controller(uint8_t pad) {
+  return (pad < CAP_TOUCH_PAD_COUNT) ? pad_ctl[pad] : CAP_TOUCH_KEY_DISABLED;
+}
+
+void cap_touch_set_lp_mode(uint8_t lp_mode) {
+  for (uint8_t i = 0; i < CAP_TOUCH_CONTROLLER_COUNT; ++i) {
+    shadow_set(&controllers[i], REG_LP_MODE, lp_mode);
+  }
+}
+
+void cap_touch_set_poll_interval(uint16_t ms) {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    poll_interval = ms;
+  }
+}
+
+static uint32_t transaction_count() {
+  i2c_stats_t bus;
+  i2c_get_stats(&bus);
+  return bus.transactions;
+}
+
+// Served from the shadow; one burst read per controller the first time
+// after a reset
+void cap_touch_read_config(cap_touch_config_t *out) {
+  uint32_t start = transaction_count();
+
+  for (uint8_t i = 0; i < CAP_TOUCH_CONTROLLER_COUNT; ++i) {
+    shadow_fill(&controllers[i], CONFIG_BLOCK_START, CONFIG_BLOCK_END);
+  }
+  shadow_to_config(out);
+
+  stats.config_transactions = transaction_count() - start;
+}
+
+// Only registers that actually change are marked dirty; they're written in
+// the background by cap_touch_update(), coalesced into as few bursts as
+// possible
+void cap_touch_write_config(cap_touch_config_t *in) {
+  config_to_shadow(in);
+}
+
+//
+// Raw key data
+
+// 16-bit key values are stored LSB first
+static uint16_t raw_word(const controller_t *ct, uint8_t reg) {
+  return ct->shadow[reg] | (ct->shadow[reg + 1] << 8);
+}
+
+static void raw_channel(cap_touch_raw_t *out, uint8_t channel, const controller_t *ct, uint8_t key) {
+  out->signal[channel] = raw_word(ct, REG_SIGNAL_BASE + key * 2);
+  out->reference[channel] = raw_word(ct, REG_REFERENCE_BASE + key * 2);
+}
+
+// The jobs a raw read is made up of
+static uint8_t raw_jobs(bool slider_only, i2c_job_t **jobs) {
+  if (slider_only) {
+    jobs[0] = &controllers[SLIDER_CONTROLLER].slider_signal_job;
+    jobs[1] = &controllers[SLIDER_CONTROLLER].slider_reference_job;
+    return 2;
+  }
+  for (uint8_t i = 0; i < CAP_TOUCH_CONTROLLER_COUNT; ++i) {
+    jobs[i] = &controllers[i].raw_job;
+  }
+  return CAP_TOUCH_CONTROLLER_COUNT;
+}
+
+#define MAX_RAW_JOBS    ((CAP_TOUCH_CONTROLLER_COUNT > 2) ? CAP_TOUCH_CONTROLLER_COUNT : 2)
+
+static bool raw_slider_only;
+
+// Queues a raw read of every key (or just the slider keys); true if it's
+// all in flight
+bool cap_touch_request_raw(bool slider_only) {
+  if (reset_state != CAP_TOUCH_RESET_READY) {
+    return false;
+  }
+  i2c_job_t *jobs[MAX_RAW_JOBS];
+  uint8_t count = raw_jobs(slider_only, jobs);
+  bool queued = true;
+  for (uint8_t i = 0; i < count; ++i) {
+    if (!I2C_PENDING(jobs[i]) && !i2c_submit(jobs[i])) {
+      queued = false;
+    }
+  }
+  raw_slider_only = slider_only;
+  return queued;
+}
+
+// True once every job of the raw read has completed successfully. After a
+// slider key read the pads read 0.
+bool cap_touch_read_raw(cap_touch_raw_t *out) {
+  i2c_job_t *jobs[MAX_RAW_JOBS];
+  uint8_t count = raw_jobs(raw_slider_only, jobs);
+  bool ok = true;
+  for (uint8_t i = 0; i < count; ++i) {
+    if (I2C_PENDING(jobs[i]) || jobs[i]->status == I2C_IDLE) {
+      return false;
+    }
+    if (jobs[i]->status != I2C_DONE) {
+      ok = false;
+    }
+  }
+
+  if (ok) {
+    for (int i = 0; i < CAP_TOUCH_PAD_COUNT; ++i) {
+      if (raw_slider_only || pad_ctl[i] == CAP_TOUCH_KEY_DISABLED) {
+        out->signal[i] = 0;
+        out->reference[i] = 0;
+      } else {
+        raw_channel(out, i, &controllers[pad_ctl[i]], pad_key[i]);
+      }
+    }
+    for (int i = 0; i < SLIDER_KEY_COUNT; ++i) {
+      raw_channel(out, CAP_TOUCH_PAD_COUNT + i, &controllers[SLIDER_CONTROLLER], SLIDER_KEY_START + i);
+    }
+  }
+
+  for (uint8_t i = 0; i < count; ++i) {
+    jobs[i]->status = I2C_IDLE;
+  }
+  return ok;
+}
+
+void cap_touch_get_stats(cap_touch_stats_t *out) {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    *out = stats;
+  }
+}
+
+void cap_touch_reset_stats() {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    memset(&stats, 0, sizeof(stats));
+  }
+}
+
+#if CAP_TOUCH_CHANGE_IRQ
+ISR(INT6_vect) {
+  if (!change_pending) {
+    change_at = micros();
   }
+  change_pending = true;
 }
+#endif
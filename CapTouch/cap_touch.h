@@ -3,7 +3,123 @@
 
 #include <stdint.h>
 
-#define CAP_TOUCH_PAD_COUNT 8
+// Controllers
+// -----------
+// Each controller has 12 keys; which logical pad each key drives is set by
+// the topology (below). The slider is on controller 0 only. The QT2120's
+// own address is fixed (0x1C) so extra controllers need to sit behind an
+// address translator (e.g. LTC4316); all controllers share the PD4 reset
+// line and a wired-OR CHANGE line.
+#ifndef CAP_TOUCH_CONTROLLER_COUNT
+#define CAP_TOUCH_CONTROLLER_COUNT      1
+#define CAP_TOUCH_ADDRESSES             { 0x1C }
+#endif
+#define CAP_TOUCH_KEYS_PER_CONTROLLER   12
+
+// Logical pads are numbered across all controllers and any key can drive
+// any of them. Up to two controllers every key can have its own pad;
+// beyond that each controller adds the original board's 8, so four still
+// fit the 32-bit pad mask.
+#if CAP_TOUCH_CONTROLLER_COUNT <= 2
+#define CAP_TOUCH_PADS_PER_CONTROLLER   CAP_TOUCH_KEYS_PER_CONTROLLER
+#else
+#define CAP_TOUCH_PADS_PER_CONTROLLER   8
+#endif
+
+#define CAP_TOUCH_PAD_COUNT (CAP_TOUCH_CONTROLLER_COUNT * CAP_TOUCH_PADS_PER_CONTROLLER)
+
+// One bit per pad, pad 0 => bit 0
+#if CAP_TOUCH_PAD_COUNT <= 8
+typedef uint8_t cap_touch_buttons_t;
+#elif CAP_TOUCH_PAD_COUNT <= 16
+typedef uint16_t cap_touch_buttons_t;
+#elif CAP_TOUCH_PAD_COUNT <= 32
+typedef uint32_t cap_touch_buttons_t;
+#else
+#error "At most 32 pads are supported"
+#endif
+
+#define CAP_TOUCH_PAD_BIT(pad)          (((cap_touch_buttons_t)1) << (pad))
+
+// Raw data channels: pads in board order (zero if unmapped), then keys 0-2
+// of controller 0 whatever their role
+#define CAP_TOUCH_SLIDER_KEY_COUNT    3
+#define CAP_TOUCH_CHANNEL_COUNT       (CAP_TOUCH_PAD_COUNT + CAP_TOUCH_SLIDER_KEY_COUNT)
+
+// Topology
+// --------
+// key_pad maps each controller key to a logical pad, or to
+// CAP_TOUCH_KEY_DISABLED. Keys 0-2 of controller 0 can instead form the
+// slider or wheel (the only keys the QT2120 can use for it), in which case
+// their key_pad entries are ignored. Disabled keys get a zero detect
+// threshold so the chip doesn't measure them. Keys given
+// CAP_TOUCH_KEY_PROXIMITY drive no pad; they're reported in the state's
+// proximity flag instead (see proximity.h).
+//
+// The default is the original board: slider on keys 0-2, pads 1-8 on keys
+// 11-4 (of each controller, numbered on from 8 per controller), key 3 off.
+#define CAP_TOUCH_KEY_DISABLED        0xFF
+#define CAP_TOUCH_KEY_PROXIMITY       0xFE
+
+#define CAP_TOUCH_SLIDER_NONE         0
+#define CAP_TOUCH_SLIDER_LINEAR       1
+#define CAP_TOUCH_SLIDER_WHEEL        2
+
+typedef struct __attribute__ ((packed)) cap_touch_topology {
+  uint8_t slider;
+  uint8_t key_pad[CAP_TOUCH_CONTROLLER_COUNT][CAP_TOUCH_KEYS_PER_CONTROLLER];
+} cap_touch_topology_t;
+
+// Slider positions are 0..CAP_TOUCH_SLIDER_MAX, -1 when untouched. The chip
+// itself only resolves 8 bits; its position is scaled up to this range.
+#define CAP_TOUCH_SLIDER_BITS         12
+#define CAP_TOUCH_SLIDER_MAX          ((1 << CAP_TOUCH_SLIDER_BITS) - 1)
+
+// Acquisition
+// -----------
+// Status reads are started from cap_touch_tick(), in the scheduler's timer
+// interrupt, and decoded in the TWI interrupt as they complete; changes go
+// to the touch queue (touch_queue.h) for cap_touch_update() to pass on. A
+// main loop held up by a USB write delays the reports, not the reads, so
+// a short tap is still seen. Until the chips are up, and while they're
+// calibrating, cap_touch_update() does the reading itself.
+//
+// With CAP_TOUCH_CHANGE_IRQ set the QT2120's CHANGE output (open drain, active
+// low, wired to INT6/PE6) marks the status dirty and a status read only
+// goes to the bus when the chip has something new to report. The poll
+// interval is a fallback so a missed edge can't leave the state stale.
+//
+// With several controllers only one status read is in flight at a time.
+// After a CHANGE, controllers are read in turn starting with the one that
+// last had something to report, stopping as soon as CHANGE is released, so
+// activity on one controller costs one read however many are fitted. The
+// fallback poll is spread across controllers so idle bus traffic doesn't
+// grow with the controller count either. Without CHANGE nothing says which
+// controller to read, so each poll reads them all, back to back, and none
+// waits longer than the poll interval.
+//
+// Off by default: the CHANGE to PE6 connection isn't confirmed for every
+// board. With it off the poll is all there is: status is read every
+// CAP_TOUCH_POLL_INTERVAL_MS (see cap_touch_set_poll_interval()), so a touch
+// can take that long to show.
+#ifndef CAP_TOUCH_CHANGE_IRQ
+#define CAP_TOUCH_CHANGE_IRQ          0
+#endif
+#define CAP_TOUCH_POLL_INTERVAL_MS    50
+
+// Calibration runs in the background; see cap_touch_cal_state()
+#define CAP_TOUCH_CAL_TIMEOUT_MS      1000
+
+// Reset also runs in the background, from cap_touch_update(); see
+// cap_touch_reset_state()
+#define CAP_TOUCH_RESET_ASSERTED      0
+#define CAP_TOUCH_RESET_BOOTING       1
+#define CAP_TOUCH_RESET_CALIBRATING   2
+#define CAP_TOUCH_RESET_READY         3
+
+#define CAP_TOUCH_CAL_IDLE            0
+#define CAP_TOUCH_CAL_RUNNING         1
+#define CAP_TOUCH_CAL_TIMEOUT         2
 
 typedef struct __attribute__ ((packed)) cap_touch_config {
   uint8_t lp_mode;
@@ -19,24 +135,71 @@ typedef struct __attribute__ ((packed)) cap_touch_config {
   uint8_t slider_pulse_scale;
 
   // Order of these arrays is relative to board order, NOT captouch IC key number
-  // e.g. index 0 => board pad 1
+  // e.g. index 0 => board pad 1. Firmware from before the topology had 8
+  // pads per controller here; ct_config still accepts that layout.
   uint8_t key_detect_threshold[CAP_TOUCH_PAD_COUNT];
   uint8_t key_control[CAP_TOUCH_PAD_COUNT];
   uint8_t key_pulse_scale[CAP_TOUCH_PAD_COUNT];
 } cap_touch_config_t;
 
 typedef struct cap_touch_state {
-	uint8_t buttons;
+	cap_touch_buttons_t buttons;
 	int slider;
+	bool proximity;
+	unsigned long read_us;    // micros() when the status it came from was read
+	unsigned long edge_us;    // ... and when CHANGE asked for that read
 } cap_touch_state_t;
 
+// Delta (reference - signal) rises with touch
+typedef struct cap_touch_raw {
+  uint16_t signal[CAP_TOUCH_CHANNEL_COUNT];
+  uint16_t reference[CAP_TOUCH_CHANNEL_COUNT];
+} cap_touch_raw_t;
+
+typedef struct cap_touch_stats {
+  uint32_t updates;       // calls to cap_touch_update()
+  uint32_t reads;         // status reads that went to the bus
+  uint32_t reads_polled;  // ...of which were due to the fallback poll interval
+  uint32_t reads_skipped; // updates or ticks with no read due
+  uint32_t total_read_us; // bus time spent on status reads
+  uint16_t last_read_us;
+  uint16_t max_read_us;
+  uint16_t flush_bursts;       // background config writes
+  uint8_t config_transactions; // bus transactions used by the last config read
+  uint8_t cal_timeouts;
+  uint8_t hw_resets;           // recoveries from an unresponsive chip
+  uint8_t config_reflushes;    // resets after which our setup was written again
+} cap_touch_stats_t;
+
 void cap_touch_init();
 void cap_touch_reset();
+uint8_t cap_touch_reset_state();
+uint16_t cap_touch_first_scan_time();
 void cap_touch_recal();
+void cap_touch_recal_controllers(uint8_t mask);
+uint8_t cap_touch_cal_state();
+uint16_t cap_touch_cal_duration();
 void cap_touch_update(cap_touch_state_t *state);
-uint8_t cap_touch_read_reg(uint8_t reg);
-void cap_touch_write_reg(uint8_t reg, uint8_t val);
+void cap_touch_tick();
+uint8_t cap_touch_read_reg(uint8_t ctl, uint8_t reg);
+void cap_touch_write_reg(uint8_t ctl, uint8_t reg, uint8_t val);
+void cap_touch_default_topology(cap_touch_topology_t *out);
+void cap_touch_get_topology(cap_touch_topology_t *out);
+bool cap_touch_set_topology(const cap_touch_topology_t *in);
+uint8_t cap_touch_slider_mode();
+void cap_touch_set_proximity(uint8_t detect_threshold, uint8_t pulse_scale);
+bool cap_touch_pad_mapped(uint8_t pad);
+uint8_t cap_touch_pad_controller(uint8_t pad);
 void cap_touch_read_config(cap_touch_config_t *out);
 void cap_touch_write_config(cap_touch_config_t *in);
 
+// Runtime scan rate control; LP_MODE goes to every controller in the
+// background like any other config write
+void cap_touch_set_lp_mode(uint8_t lp_mode);
+void cap_touch_set_poll_interval(uint16_t ms);
+bool cap_touch_request_raw(bool slider_only);
+bool cap_touch_read_raw(cap_touch_raw_t *out);
+void cap_touch_get_stats(cap_touch_stats_t *out);
+void cap_touch_reset_stats();
+
 #endif
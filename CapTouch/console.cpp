@@ -3,6 +3,21 @@
 #include "Arduino.h"
 #include "settings.h"
 #include "cap_touch.h"
+#include "i2c.h"
+#include "signal_capture.h"
+#include "slider_filter.h"
+#include "slider_engine.h"
+#include "lp_governor.h"
+#include "drift_monitor.h"
+#include "auto_tune.h"
+#include "proximity.h"
+#include "key_filter.h"
+#include "touch_history.h"
+#include "touch_queue.h"
+#include "scheduler.h"
+#include "profiler.h"
+#include "latency.h"
+#include "stall_monitor.h"
 #include "led_driver.h"
 #include "leds.h"
 #include "mode_selection.h"
@@ -27,15 +42,32 @@ static bool quiet;
 
 static int doClearSettings(char*);
 static int doCTConfig(char*);
+static int doCTDrift(char*);
+static int doCTHistory(char*);
+static int doCTKeys(char*);
+static int doCTLP(char*);
+static int doCTProx(char*);
+static int doCTQueue(char*);
 static int doCTRecal(char*);
 static int doCTReg(char*);
 static int doCTReset(char*);
+static int doCTSignals(char*);
+static int doCTStats(char*);
+static int doCTTopology(char*);
+static int doCTTune(char*);
 static int doHello(char*);
 static int doIdent(char*);
+static int doLatency(char*);
 static int doLED(char*);
 static int doMIDI(char*);
 static int doMode(char*);
 static int doSave(char*);
+static int doSched(char*);
+static int doSlider(char*);
+static int doStall(char*);
+#if PT_PROFILING
+static int doStats(char*);
+#endif
 static int doTrack(char*);
 
 struct command_handler {
@@ -46,15 +78,32 @@ struct command_handler {
 static const command_handler handlers[] = {
   { "clear_settings", doClearSettings },
   { "ct_config",      doCTConfig      },
+  { "ct_drift",       doCTDrift       },
+  { "ct_history",     doCTHistory     },
+  { "ct_keys",        doCTKeys        },
+  { "ct_lp",          doCTLP          },
+  { "ct_prox",        doCTProx        },
+  { "ct_queue",       doCTQueue       },
   { "ct_recal",       doCTRecal       },
   { "ct_reg",         doCTReg         },
   { "ct_reset",       doCTReset       },
+  { "ct_signals",     doCTSignals     },
+  { "ct_stats",       doCTStats       },
+  { "ct_topology",    doCTTopology    },
+  { "ct_tune",        doCTTune        },
   { "hello",          doHello         },
   { "ident",          doIdent         },
+  { "latency",        doLatency       },
   { "led",            doLED           },
   { "midi",           doMIDI          },
   { "mode",           doMode          },
   { "save",           doSave          },
+  { "sched",          doSched         },
+  { "slider",         doSlider        },
+  { "stall",          doStall         },
+#if PT_PROFILING
+  { "stats",          doStats         },
+#endif
   { "track",          doTrack         },
   { NULL,             NULL            }
 };
@@ -66,20 +115,153 @@ static const char usage_ct_config[] PROGMEM =
   "ct_config         : read cap touch config\r\n"
   "ct_config <config>: write cap touch config\r\n"
   "\r\n"
-  "<config>: 34 byte config string (hex-encoded)";  
+  "<config>: config string (hex-encoded), 10 bytes + 3 per pad. The old\r\n"
+  "          8 pads per controller layout is still accepted; the pads it\r\n"
+  "          doesn't cover keep their settings";  
+
+static const char usage_ct_drift[] PROGMEM =
+  "ct_drift                  : get drift monitor config and event counters\r\n"
+  "ct_drift <stuck> <limit>  : set drift monitor limits\r\n"
+  "ct_drift [on | off]       : enable/disable the drift monitor\r\n"
+  "ct_drift reset            : reset event counters\r\n"
+  "\r\n"
+  "<stuck>: seconds a pad can stay touched before recalibrating (0 = never)\r\n"
+  "<limit>: reference drift/negative delta that triggers recalibration\r\n"
+  "\r\n"
+  "Counters are automatic recalibrations, then stuck and drift events per\r\n"
+  "channel.";
+
+static const char usage_ct_history[] PROGMEM =
+  "ct_history      : dump recent touch events, oldest first\r\n"
+  "ct_history bin  : dump recent touch events as binary\r\n"
+  "ct_history clear: clear the touch event history\r\n"
+  "\r\n"
+  "The first line has the number of events that follow and the number\r\n"
+  "recorded since the last clear. Events are 6 bytes: micros() timestamp\r\n"
+  "(MSB first), event (kind in bits 7-6: pad up, pad down, slider up,\r\n"
+  "slider down; bit 5 set once emitted, clear when read; pad in bits 4-0)\r\n"
+  "and slider position (8 bits). The hex dump has one event per line; bin\r\n"
+  "sends a count byte and then the events with no separators.";
+
+static const char usage_ct_keys[] PROGMEM =
+  "ct_keys                  : get key filter config and counters\r\n"
+  "ct_keys <on> <off>       : set debounce counts\r\n"
+  "ct_keys [on | off]       : enable/disable the key filter\r\n"
+  "ct_keys groups none | aks: no groups, or groups from key control AKS bits\r\n"
+  "ct_keys groups <groups>  : set firmware groups\r\n"
+  "ct_keys reset            : reset counters\r\n"
+  "\r\n"
+  "<on>, <off>: steps (10ms) a touch/release must last to count (1-7)\r\n"
+  "<groups>   : 1 byte per pad (hex-encoded), group 1-4 or 0 for none\r\n"
+  "\r\n"
+  "Only the strongest touched pad in a group is reported. Counters are\r\n"
+  "debounce steps that rejected a bounce, then touches suppressed by a\r\n"
+  "stronger pad.";
+
+static const char usage_ct_lp[] PROGMEM =
+  "ct_lp                              : get scan rate governor config and state\r\n"
+  "ct_lp <fast> <slow> <fdwell> <idle>: set scan rate governor config\r\n"
+  "ct_lp [on | off]                   : enable/disable the governor (default off)\r\n"
+  "ct_lp reset                        : reset time counters\r\n"
+  "\r\n"
+  "<fast>, <slow>: LP_MODE while in use/idle (1-255, 16ms units)\r\n"
+  "<fdwell>      : minimum time in fast mode (0-30000 ms)\r\n"
+  "<idle>        : time without touches before going slow (0-30000 s)\r\n"
+  "\r\n"
+  "State is fast or slow, followed by the time spent in each (ms) and the\r\n"
+  "number of transitions.";
+
+static const char usage_ct_prox[] PROGMEM =
+  "ct_prox                        : get proximity wake config and state\r\n"
+  "ct_prox off                    : disable proximity wake\r\n"
+  "ct_prox key [<thresh> <pscale>]: use the proximity keys\r\n"
+  "ct_prox sum [<thresh>]         : use the sum of pad deltas\r\n"
+  "ct_prox reset                  : reset counters\r\n"
+  "\r\n"
+  "<thresh>: detect threshold (key, 1-255) or summed delta (sum, 1-30000)\r\n"
+  "<pscale>: pulse/scale of the proximity keys (0-255)\r\n"
+  "\r\n"
+  "Proximity keys are those set to fe with ct_topology. State is near or\r\n"
+  "far, followed by the number of wakes and the time from the last wake to\r\n"
+  "the touch that followed (ms).";
+
+static const char usage_ct_queue[] PROGMEM =
+  "ct_queue      : get touch queue counters\r\n"
+  "ct_queue reset: reset touch queue counters\r\n"
+  "\r\n"
+  "The queue carries touch changes from the status read interrupt to the\r\n"
+  "scan stage. Shows entries waiting now, entries queued, overflows\r\n"
+  "(changes dropped with the queue full) and the most ever waiting at once.";
 
 static const char usage_ct_recal[] PROGMEM =
-  "ct_recal: recalibrate the cap touch IC";
+  "ct_recal       : start recalibrating the cap touch IC\r\n"
+  "ct_recal status: get recalibration status and duration (ms)\r\n"
+  "\r\n"
+  "Recalibration runs in the background; the ident LED is lit until it\r\n"
+  "completes. Status is one of idle, running, timeout.";
 
 static const char usage_ct_reg[] PROGMEM =
   "ct_reg <reg>      : read cap touch register\r\n"
   "ct_reg <reg> <val>: write cap touch register\r\n"
   "\r\n"
-  "<reg>: register (0-99)\r\n"
+  "<reg>: register (0-99), or <ctl>:<reg> for controllers after the first\r\n"
   "<val>: value (0-255)";
 
 static const char usage_ct_reset[] PROGMEM =
-  "ct_reset: reset the cap touch IC";
+  "ct_reset       : reset the cap touch IC\r\n"
+  "ct_reset status: get reset status and time to first valid scan (ms)\r\n"
+  "\r\n"
+  "Reset runs in the background. Status is one of asserted, booting,\r\n"
+  "calibrating, ready; the time counts up until the chip is ready.";
+
+static const char usage_ct_signals[] PROGMEM =
+  "ct_signals           : get per-channel key data and delta statistics\r\n"
+  "ct_signals rate <ms> : ask for capture every <ms> (0 = stop asking)\r\n"
+  "ct_signals reset     : reset delta statistics\r\n"
+  "ct_signals dump      : dump recent deltas, oldest first\r\n"
+  "\r\n"
+  "Capture runs at the fastest rate asked for here or by any feature that\r\n"
+  "needs it; rate shows what it's running at.\r\n"
+  "\r\n"
+  "Channels are pads p1-pN then slider keys s1-s3. Statistics are delta\r\n"
+  "mean, variance and peak-to-peak. Dump lines are one frame each, 16-bit\r\n"
+  "signed deltas hex-encoded MSB first.";
+
+static const char usage_ct_stats[] PROGMEM =
+  "ct_stats      : get cap touch acquisition and bus counters\r\n"
+  "ct_stats reset: reset cap touch acquisition and bus counters\r\n"
+  "\r\n"
+  "bus_us      : status read bus time in us (last/max/total)\r\n"
+  "cfg_xfers   : bus transactions used by the last config read\r\n"
+  "flushes     : background config write bursts\r\n"
+  "cal_timeouts: recalibrations that didn't complete in time\r\n"
+  "hw_resets   : hardware resets after the IC stopped responding\r\n"
+  "reflushes   : resets after which the config was written again\r\n"
+  "i2c         : bus transactions/NACKs/bus errors/timeouts/bus clears\r\n"
+  "i2c_block_us: longest time a caller was blocked on the bus";
+
+static const char usage_ct_topology[] PROGMEM =
+  "ct_topology                  : get slider mode and key-to-pad maps\r\n"
+  "ct_topology <ctl> <map>      : set the key-to-pad map of a controller\r\n"
+  "ct_topology slider <mode>    : set slider mode\r\n"
+  "\r\n"
+  "<ctl> : controller (0 = first)\r\n"
+  "<map> : 12 bytes (hex-encoded), pad index (0 = p1) for keys 0-11,\r\n"
+  "        fe = proximity, ff = off\r\n"
+  "<mode>: none, slider, wheel; uses keys 0-2 of controller 0\r\n"
+  "\r\n"
+  "Pads keep their settings when they move; the keys are recalibrated.";
+
+static const char usage_ct_tune[] PROGMEM =
+  "ct_tune       : start auto-tuning pad sensitivity\r\n"
+  "ct_tune status: get auto-tune progress and results\r\n"
+  "ct_tune abort : stop auto-tuning and restore the previous config\r\n"
+  "\r\n"
+  "Touch and release every pad once, then keep clear of the pads while the\r\n"
+  "candidate settings are measured. The result is saved as the power-on\r\n"
+  "defaults. Status is one of idle, touch, sweep, done, failed with progress\r\n"
+  "through the phase; when done, each pad's pulse/scale, threshold and\r\n"
+  "predicted signal-to-noise ratio follow.";
 
 static const char usage_hello[] PROGMEM =
   "hello: get product name and version";
@@ -87,6 +269,14 @@ static const char usage_hello[] PROGMEM =
 static const char usage_ident[] PROGMEM =
   "ident [on | off]: turn ident LED on/off";
 
+static const char usage_latency[] PROGMEM =
+  "latency      : get touch-to-USB latency histograms\r\n"
+  "latency reset: reset touch-to-USB latency histograms\r\n"
+  "\r\n"
+  "One line per mode: reports timed, mean and worst latency (us), then the\r\n"
+  "histogram: <512us, <1ms, <2ms and so on, doubling, the last open-ended.\r\n"
+  "The last line has the edges dropped for not producing a report.";
+
 static const char usage_led[] PROGMEM =
   "led off            : turn off all RGB LEDs\r\n"
   "led <color>        : set all LEDs to <color>\r\n"
@@ -97,9 +287,13 @@ static const char usage_led[] PROGMEM =
 static const char usage_midi[] PROGMEM =
   "midi                       : get MIDI config\r\n"
   "midi <channel> <controller>: set MIDI config\r\n"
+  "midi gestures <on | off>   : slider gestures change program\r\n"
   "\r\n"
   "<channel>   : MIDI channel (1-16)\r\n"
-  "<controller>: MIDI controller (0-127, 0 = pitch bend)";
+  "<controller>: MIDI controller (0-127, 0 = pitch bend)\r\n"
+  "\r\n"
+  "With gestures on, swipes step the program and flicks jump eight, and\r\n"
+  "the slider sends no pitch bend or controller changes.";
 
 static const char usage_mode[] PROGMEM =
   "mode       : get active report mode\r\n"
@@ -110,6 +304,48 @@ static const char usage_mode[] PROGMEM =
 static const char usage_save[] PROGMEM =
   "save: save active settings to EEPROM as the power-on defaults";
 
+static const char usage_sched[] PROGMEM =
+  "sched      : get scheduler stage timing and overrun counters\r\n"
+  "sched reset: reset scheduler counters\r\n"
+  "\r\n"
+  "One line per stage, highest priority first: period (ms), runs, overruns\r\n"
+  "(slots missed altogether), longest delay past its slot (ms) and longest\r\n"
+  "run time (us).";
+
+static const char usage_slider[] PROGMEM =
+  "slider                             : get slider filter config and counters\r\n"
+  "slider <smoothing> <deadband> <hyst>: set slider filter config\r\n"
+  "slider reset                       : reset slider filter counters\r\n"
+  "slider engine [on | off]           : use firmware slider interpolation\r\n"
+  "\r\n"
+  "Positions are 0-4095. With the engine on, position is interpolated from\r\n"
+  "the slider key signals rather than taken from the IC's 8-bit output.\r\n"
+  "\r\n"
+  "<smoothing>: IIR strength (0-7, 0 = off)\r\n"
+  "<deadband> : position changes to ignore (0-255)\r\n"
+  "<hyst>     : extra change needed to reverse direction (0-255)\r\n"
+  "\r\n"
+  "Counters are raw position changes, how many of those were suppressed,\r\n"
+  "and suppressions over the last second.";
+
+static const char usage_stall[] PROGMEM =
+  "stall      : get stage deadline overruns and the last stall\r\n"
+  "stall reset: reset overrun counters and forget the last stall\r\n"
+  "\r\n"
+  "One line per stage with its deadline (us) and how often it ran past it,\r\n"
+  "then the last stall: overrun (came back late) or watchdog (never came\r\n"
+  "back, board was reset), the stage and where in it, time in the stage\r\n"
+  "(us) and uptime (ms). It survives a watchdog reset, not a power cycle.";
+
+#if PT_PROFILING
+static const char usage_stats[] PROGMEM =
+  "stats      : get per-stage cycle counts\r\n"
+  "stats reset: reset per-stage cycle counts\r\n"
+  "\r\n"
+  "One line per stage or interrupt handler: calls, then min/avg/max CPU\r\n"
+  "cycles per call.";
+#endif
+
 static const char usage_track[] PROGMEM =
   "track           : get LED tracking status\r\n"
   "track [on | off]: set LED tracking status\r\n"
@@ -120,18 +356,66 @@ static const char usage_track[] PROGMEM =
 static const char *const usage_strings[] PROGMEM = {
   usage_clear_settings,
   usage_ct_config,
+  usage_ct_drift,
+  usage_ct_history,
+  usage_ct_keys,
+  usage_ct_lp,
+  usage_ct_prox,
+  usage_ct_queue,
   usage_ct_recal,
   usage_ct_reg,
   usage_ct_reset,
+  usage_ct_signals,
+  usage_ct_stats,
+  usage_ct_topology,
+  usage_ct_tune,
   usage_hello,
   usage_ident,
+  usage_latency,
   usage_led,
   usage_midi,
   usage_mode,
   usage_save,
+  usage_sched,
+  usage_slider,
+  usage_stall,
+#if PT_PROFILING
+  usage_stats,
+#endif
   usage_track
 };
 
+static const char* reset_state_names[] = {
+  "asserted",
+  "booting",
+  "calibrating",
+  "ready"
+};
+
+static const char* cal_state_names[] = {
+  "idle",
+  "running",
+  "timeout"
+};
+
+static const char* slider_mode_names[] = {
+  "none",
+  "slider",
+  "wheel"
+};
+
+static const char* key_group_names[] = {
+  "none",
+  "aks",
+  "fw"
+};
+
+static const char* proximity_source_names[] = {
+  "off",
+  "key",
+  "sum"
+};
+
 static const char* mode_names[] = {
   "serial",
   "numeric",
@@ -154,6 +438,21 @@ static int ok() {
   return OK;
 }
 
+// Stage and, where it has one, the mark within it
+static void print_stall_where(const stall_record_t *r) {
+  if (r->stage >= SCHEDULER_STAGE_COUNT) {
+    CONSOLE_PORT.print("-");
+    return;
+  }
+  CONSOLE_PORT.print(scheduler_stage_name(r->stage));
+  if (r->stage == SCHEDULER_STAGE_SCAN) {
+    CONSOLE_PORT.print(r->mark == STALL_MARK_EMIT ? F("/emit") : F("/acquire"));
+  } else if (r->stage == SCHEDULER_STAGE_CONSOLE && r->mark > 0 && r->mark < sizeof(handlers) / sizeof(handlers[0])) {
+    CONSOLE_PORT.print("/");
+    CONSOLE_PORT.print(handlers[r->mark - 1].op);
+  }
+}
+
 static void print_hex_byte(uint8_t val) {
   if (quiet) {
     return;
@@ -364,6 +663,7 @@ static void dispatch() {
         return;
       }
       
+      stall_monitor_mark(i + 1);
       int ret = handlers[i].handler(first_arg);
       if (!quiet) {
         switch (ret) {
@@ -430,11 +730,43 @@ void console_tick() {
 //
 // Command handlers
 
+static void print_channel_name(uint8_t ch) {
+  if (ch < CAP_TOUCH_PAD_COUNT) {
+    CONSOLE_PORT.print('p');
+    CONSOLE_PORT.print(ch + 1);
+  } else {
+    CONSOLE_PORT.print('s');
+    CONSOLE_PORT.print(ch - CAP_TOUCH_PAD_COUNT + 1);
+  }
+}
+
 static int doClearSettings(char *ignore) {
   defaults_clear();
   return ok();
 }
 
+// ct_config blobs from before the topology carry 8 pads per controller
+#define CT_CONFIG_HEAD_SIZE     offsetof(cap_touch_config_t, key_detect_threshold)
+#define CT_CONFIG_OLD_PADS      (CAP_TOUCH_CONTROLLER_COUNT * 8)
+#define CT_CONFIG_OLD_SIZE      (CT_CONFIG_HEAD_SIZE + CT_CONFIG_OLD_PADS * 3)
+
+static int parseOldCTConfig(cap_touch_config_t *cfg, const char *blob) {
+  uint8_t old[CT_CONFIG_OLD_SIZE];
+  int err = parseHex(old, blob, sizeof(old));
+  if (err < 0) {
+    return err;
+  }
+  const uint8_t *src = old;
+  memcpy(cfg, src, CT_CONFIG_HEAD_SIZE);
+  src += CT_CONFIG_HEAD_SIZE;
+  memcpy(cfg->key_detect_threshold, src, CT_CONFIG_OLD_PADS);
+  src += CT_CONFIG_OLD_PADS;
+  memcpy(cfg->key_control, src, CT_CONFIG_OLD_PADS);
+  src += CT_CONFIG_OLD_PADS;
+  memcpy(cfg->key_pulse_scale, src, CT_CONFIG_OLD_PADS);
+  return OK;
+}
+
 static int doCTConfig(char *blob) {
   cap_touch_config_t cfg;
 
@@ -451,7 +783,13 @@ static int doCTConfig(char *blob) {
     return OK;
   }
 
-  int err = parseHex((uint8_t*)&cfg, blob, sizeof(cap_touch_config_t));
+  int err;
+  if (strlen(blob) == CT_CONFIG_OLD_SIZE * 2) {
+    cap_touch_read_config(&cfg);
+    err = parseOldCTConfig(&cfg, blob);
+  } else {
+    err = parseHex((uint8_t*)&cfg, blob, sizeof(cap_touch_config_t));
+  }
   if (err < 0) {
     return EARG;
   }
@@ -460,21 +798,368 @@ static int doCTConfig(char *blob) {
   return ok();
 }
 
-static int doCTRecal(char *ignore) {
-  cap_touch_recal();
+static int doCTDrift(char *arg) {
+  uint16_t stuck_s, limit;
+  drift_monitor_get_limits(&stuck_s, &limit);
+
+  if (!arg) {
+    if (!quiet) {
+      drift_monitor_stats_t stats;
+      drift_monitor_get_stats(&stats);
+      CONSOLE_PORT.print(F("ct_drift: "));
+      CONSOLE_PORT.print(drift_monitor_is_enabled() ? "on " : "off ");
+      CONSOLE_PORT.print(stuck_s);
+      CONSOLE_PORT.print(" ");
+      CONSOLE_PORT.print(limit);
+      CONSOLE_PORT.print(F(" recals="));
+      CONSOLE_PORT.println(stats.recals);
+      for (int ch = 0; ch < CAP_TOUCH_CHANNEL_COUNT; ++ch) {
+        print_channel_name(ch);
+        CONSOLE_PORT.print(F(": stuck="));
+        CONSOLE_PORT.print((ch < CAP_TOUCH_PAD_COUNT) ? stats.stuck[ch] : 0);
+        CONSOLE_PORT.print(F(" drift="));
+        CONSOLE_PORT.println(stats.drift[ch]);
+      }
+    }
+    return OK;
+  }
+
+  if (EQ(arg, "reset")) {
+    drift_monitor_reset_stats();
+    return ok();
+  }
+
+  bool on;
+  if (parseBool(arg, &on)) {
+    drift_monitor_set_enabled(on);
+    return ok();
+  }
+
+  char *str_limit = next_arg();
+  if (!str_limit)
+    return EUSAGE;
+
+  int new_stuck_s, new_limit;
+  if (!parseInt(arg, &new_stuck_s) || !parseInt(str_limit, &new_limit))
+    return EARG;
+
+  if (new_stuck_s < 0 || new_stuck_s > 30000 || new_limit < 1 || new_limit > 2047)
+    return EARG;
+
+  drift_monitor_set_limits(new_stuck_s, new_limit);
+  return ok();
+}
+
+static int doCTHistory(char *arg) {
+  bool binary = false;
+  if (arg) {
+    if (EQ(arg, "clear")) {
+      touch_history_clear();
+      return ok();
+    }
+    if (!EQ(arg, "bin"))
+      return EARG;
+    binary = true;
+  }
+
+  if (quiet) {
+    return OK;
+  }
+
+  uint8_t len = touch_history_length();
+  CONSOLE_PORT.print(F("ct_history: "));
+  CONSOLE_PORT.print(len);
+  CONSOLE_PORT.print(" ");
+  CONSOLE_PORT.println(touch_history_total());
+
+  if (binary) {
+    CONSOLE_PORT.write(len);
+  }
+  for (uint8_t i = 0; i < len; ++i) {
+    const touch_event_t *e = touch_history_get(i);
+    uint8_t bytes[sizeof(touch_event_t)] = {
+      (uint8_t)(e->us >> 24), (uint8_t)(e->us >> 16), (uint8_t)(e->us >> 8), (uint8_t)e->us,
+      e->event, e->value
+    };
+    if (binary) {
+      CONSOLE_PORT.write(bytes, sizeof(bytes));
+      continue;
+    }
+    for (uint8_t b = 0; b < sizeof(bytes); ++b) {
+      print_hex_byte(bytes[b]);
+    }
+    CONSOLE_PORT.println("");
+  }
+  return OK;
+}
+
+static int doCTKeys(char *arg) {
+  key_filter_config_t cfg;
+  key_filter_get_config(&cfg);
+
+  if (!arg) {
+    if (!quiet) {
+      key_filter_stats_t stats;
+      key_filter_get_stats(&stats);
+      CONSOLE_PORT.print(F("ct_keys: "));
+      CONSOLE_PORT.print(cfg.enabled ? "on " : "off ");
+      CONSOLE_PORT.print(cfg.on_count);
+      CONSOLE_PORT.print(" ");
+      CONSOLE_PORT.print(cfg.off_count);
+      CONSOLE_PORT.print(F(" groups="));
+      CONSOLE_PORT.print(key_group_names[cfg.groups]);
+      if (cfg.groups == KEY_FILTER_GROUPS_FIRMWARE) {
+        CONSOLE_PORT.print(":");
+        for (int i = 0; i < CAP_TOUCH_PAD_COUNT; ++i) {
+          print_hex_byte(cfg.group[i]);
+        }
+      }
+      CONSOLE_PORT.print(F(" bounces="));
+      CONSOLE_PORT.print(stats.bounces);
+      CONSOLE_PORT.print(F(" suppressed="));
+      CONSOLE_PORT.println(stats.suppressed);
+    }
+    return OK;
+  }
+
+  if (EQ(arg, "reset")) {
+    key_filter_reset_stats();
+    return ok();
+  }
+
+  bool on;
+  if (parseBool(arg, &on)) {
+    cfg.enabled = on;
+    key_filter_set_config(&cfg);
+    return ok();
+  }
+
+  char *str = next_arg();
+  if (!str)
+    return EUSAGE;
+
+  if (EQ(arg, "groups")) {
+    if (EQ(str, "none")) {
+      cfg.groups = KEY_FILTER_GROUPS_NONE;
+    } else if (EQ(str, "aks")) {
+      cfg.groups = KEY_FILTER_GROUPS_AKS;
+    } else {
+      if (parseHex(cfg.group, str, CAP_TOUCH_PAD_COUNT) < 0)
+        return EARG;
+      for (int i = 0; i < CAP_TOUCH_PAD_COUNT; ++i) {
+        if (cfg.group[i] > KEY_FILTER_GROUP_COUNT)
+          return EARG;
+      }
+      cfg.groups = KEY_FILTER_GROUPS_FIRMWARE;
+    }
+    key_filter_set_config(&cfg);
+    return ok();
+  }
+
+  int on_count, off_count;
+  if (!parseInt(arg, &on_count) || !parseInt(str, &off_count))
+    return EARG;
+
+  if (on_count < 1 || on_count > KEY_FILTER_MAX_COUNT || off_count < 1 || off_count > KEY_FILTER_MAX_COUNT)
+    return EARG;
+
+  cfg.on_count = on_count;
+  cfg.off_count = off_count;
+  key_filter_set_config(&cfg);
+  return ok();
+}
+
+static int doCTLP(char *arg) {
+  lp_governor_config_t cfg;
+  lp_governor_get_config(&cfg);
+
+  if (!arg) {
+    if (!quiet) {
+      lp_governor_stats_t stats;
+      lp_governor_get_stats(&stats);
+      CONSOLE_PORT.print(F("ct_lp: "));
+      CONSOLE_PORT.print(cfg.enabled ? "on " : "off ");
+      CONSOLE_PORT.print(cfg.fast_lp);
+      CONSOLE_PORT.print(" ");
+      CONSOLE_PORT.print(cfg.slow_lp);
+      CONSOLE_PORT.print(" ");
+      CONSOLE_PORT.print(cfg.fast_dwell);
+      CONSOLE_PORT.print(" ");
+      CONSOLE_PORT.print(cfg.idle_dwell);
+      CONSOLE_PORT.print(F(" state="));
+      CONSOLE_PORT.print((lp_governor_state() == LP_GOVERNOR_FAST) ? "fast" : "slow");
+      CONSOLE_PORT.print(F(" fast_ms="));
+      CONSOLE_PORT.print(stats.fast_ms);
+      CONSOLE_PORT.print(F(" slow_ms="));
+      CONSOLE_PORT.print(stats.slow_ms);
+      CONSOLE_PORT.print(F(" transitions="));
+      CONSOLE_PORT.println(stats.transitions);
+    }
+    return OK;
+  }
+
+  if (EQ(arg, "reset")) {
+    lp_governor_reset_stats();
+    return ok();
+  }
+
+  bool on;
+  if (parseBool(arg, &on)) {
+    cfg.enabled = on;
+    lp_governor_set_config(&cfg);
+    return ok();
+  }
+
+  char *str_slow = next_arg();
+  char *str_fdwell = next_arg();
+  char *str_idle = next_arg();
+  if (!str_slow || !str_fdwell || !str_idle)
+    return EUSAGE;
+
+  int fast, slow, fdwell, idle;
+  if (!parseInt(arg, &fast) || !parseInt(str_slow, &slow) || !parseInt(str_fdwell, &fdwell) || !parseInt(str_idle, &idle))
+    return EARG;
+
+  if (fast < 1 || fast > 255 || slow < 1 || slow > 255 || fdwell < 0 || fdwell > 30000 || idle < 0 || idle > 30000)
+    return EARG;
+
+  cfg.fast_lp = fast;
+  cfg.slow_lp = slow;
+  cfg.fast_dwell = fdwell;
+  cfg.idle_dwell = idle;
+  lp_governor_set_config(&cfg);
+  return ok();
+}
+
+static int doCTProx(char *arg) {
+  proximity_config_t cfg;
+  proximity_get_config(&cfg);
+
+  if (!arg) {
+    if (!quiet) {
+      proximity_stats_t stats;
+      proximity_get_stats(&stats);
+      CONSOLE_PORT.print(F("ct_prox: "));
+      CONSOLE_PORT.print(proximity_source_names[cfg.source]);
+      CONSOLE_PORT.print(F(" key="));
+      CONSOLE_PORT.print(cfg.key_threshold);
+      CONSOLE_PORT.print("/0x");
+      print_hex_byte(cfg.pulse_scale);
+      CONSOLE_PORT.print(F(" sum="));
+      CONSOLE_PORT.print(cfg.sum_threshold);
+      CONSOLE_PORT.print(F(" state="));
+      CONSOLE_PORT.print(proximity_is_near() ? "near" : "far");
+      CONSOLE_PORT.print(F(" wakes="));
+      CONSOLE_PORT.print(stats.wakes);
+      CONSOLE_PORT.print(F(" lead_ms="));
+      CONSOLE_PORT.println(stats.lead_ms);
+    }
+    return OK;
+  }
+
+  if (EQ(arg, "reset")) {
+    proximity_reset_stats();
+    return ok();
+  }
+
+  char *str_thresh = next_arg();
+  int thresh;
+  if (str_thresh && !parseInt(str_thresh, &thresh)) {
+    return EARG;
+  }
+
+  if (EQ(arg, "off")) {
+    cfg.source = PROXIMITY_OFF;
+  } else if (EQ(arg, "key")) {
+    cfg.source = PROXIMITY_KEY;
+    if (str_thresh) {
+      char *str_pscale = next_arg();
+      int pscale;
+      if (!str_pscale)
+        return EUSAGE;
+      if (!parseInt(str_pscale, &pscale) || thresh < 1 || thresh > 255 || pscale < 0 || pscale > 255)
+        return EARG;
+      cfg.key_threshold = thresh;
+      cfg.pulse_scale = pscale;
+    }
+  } else if (EQ(arg, "sum")) {
+    cfg.source = PROXIMITY_SUM;
+    if (str_thresh) {
+      if (thresh < 1 || thresh > 30000)
+        return EARG;
+      cfg.sum_threshold = thresh;
+    }
+  } else {
+    return EARG;
+  }
+
+  proximity_set_config(&cfg);
   return ok();
 }
 
+static int doCTQueue(char *arg) {
+  if (arg) {
+    if (!EQ(arg, "reset"))
+      return EARG;
+    touch_queue_reset_stats();
+    return ok();
+  }
+
+  if (!quiet) {
+    touch_queue_stats_t stats;
+    touch_queue_get_stats(&stats);
+    CONSOLE_PORT.print(F("ct_queue: length="));
+    CONSOLE_PORT.print(touch_queue_length());
+    CONSOLE_PORT.print("/");
+    CONSOLE_PORT.print(TOUCH_QUEUE_DEPTH);
+    CONSOLE_PORT.print(F(" queued="));
+    CONSOLE_PORT.print(stats.queued);
+    CONSOLE_PORT.print(F(" overflows="));
+    CONSOLE_PORT.print(stats.overflows);
+    CONSOLE_PORT.print(F(" high_water="));
+    CONSOLE_PORT.println(stats.high_water);
+  }
+  return OK;
+}
+
+static int doCTRecal(char *arg) {
+  if (!arg) {
+    cap_touch_recal();
+    return ok();
+  }
+
+  if (!EQ(arg, "status"))
+    return EARG;
+
+  if (!quiet) {
+    CONSOLE_PORT.print(F("ct_recal: "));
+    CONSOLE_PORT.print(cal_state_names[cap_touch_cal_state()]);
+    CONSOLE_PORT.print(" ");
+    CONSOLE_PORT.println(cap_touch_cal_duration());
+  }
+  return OK;
+}
+
 static int doCTReg(char *regstr) {
   if (!regstr)
     return EUSAGE;
 
+  int ctl = 0;
+  char *sep = strchr(regstr, ':');
+  if (sep) {
+    *sep = '\0';
+    if (!parseInt(regstr, &ctl)) {
+      return EARG;
+    }
+    regstr = sep + 1;
+  }
+
   int reg;
   if (!parseInt(regstr, &reg)) {
     return EARG;
   }
 
-  if (reg < 0 || reg > 99) {
+  if (ctl < 0 || ctl >= CAP_TOUCH_CONTROLLER_COUNT || reg < 0 || reg > 99) {
     return EARG;
   }
 
@@ -482,7 +1167,7 @@ static int doCTReg(char *regstr) {
   if (!valstr) {
     if (!quiet) {
       CONSOLE_PORT.print(F("ct_reg: 0x"));
-      print_hex_byte(cap_touch_read_reg(reg));
+      print_hex_byte(cap_touch_read_reg(ctl, reg));
       CONSOLE_PORT.println("");  
     }
     return OK;
@@ -497,18 +1182,273 @@ static int doCTReg(char *regstr) {
     return EARG;
   }
 
-  cap_touch_write_reg(reg, val);
+  cap_touch_write_reg(ctl, reg, val);
   return ok();
 }
 
-static int doCTReset(char *ignore) {
-  cap_touch_reset();
+static int doCTReset(char *arg) {
+  if (!arg) {
+    cap_touch_reset();
+    return ok();
+  }
+
+  if (!EQ(arg, "status"))
+    return EARG;
+
+  if (!quiet) {
+    CONSOLE_PORT.print(F("ct_reset: "));
+    CONSOLE_PORT.print(reset_state_names[cap_touch_reset_state()]);
+    CONSOLE_PORT.print(" ");
+    CONSOLE_PORT.println(cap_touch_first_scan_time());
+  }
+  return OK;
+}
+
+static int doCTStats(char *arg) {
+  if (arg) {
+    if (!EQ(arg, "reset"))
+      return EARG;
+    cap_touch_reset_stats();
+    i2c_reset_stats();
+    return ok();
+  }
+
+  if (!quiet) {
+    cap_touch_stats_t stats;
+    cap_touch_get_stats(&stats);
+    CONSOLE_PORT.print(F("ct_stats: updates="));
+    CONSOLE_PORT.print(stats.updates);
+    CONSOLE_PORT.print(F(" reads="));
+    CONSOLE_PORT.print(stats.reads);
+    CONSOLE_PORT.print(F(" polled="));
+    CONSOLE_PORT.print(stats.reads_polled);
+    CONSOLE_PORT.print(F(" skipped="));
+    CONSOLE_PORT.print(stats.reads_skipped);
+    CONSOLE_PORT.print(F(" bus_us="));
+    CONSOLE_PORT.print(stats.last_read_us);
+    CONSOLE_PORT.print("/");
+    CONSOLE_PORT.print(stats.max_read_us);
+    CONSOLE_PORT.print("/");
+    CONSOLE_PORT.print(stats.total_read_us);
+    CONSOLE_PORT.print(F(" cfg_xfers="));
+    CONSOLE_PORT.print(stats.config_transactions);
+    CONSOLE_PORT.print(F(" flushes="));
+    CONSOLE_PORT.print(stats.flush_bursts);
+    CONSOLE_PORT.print(F(" cal_timeouts="));
+    CONSOLE_PORT.print(stats.cal_timeouts);
+    CONSOLE_PORT.print(F(" hw_resets="));
+    CONSOLE_PORT.print(stats.hw_resets);
+    CONSOLE_PORT.print(F(" reflushes="));
+    CONSOLE_PORT.print(stats.config_reflushes);
+
+    i2c_stats_t bus;
+    i2c_get_stats(&bus);
+    CONSOLE_PORT.print(F(" i2c="));
+    CONSOLE_PORT.print(bus.transactions);
+    CONSOLE_PORT.print("/");
+    CONSOLE_PORT.print(bus.nacks);
+    CONSOLE_PORT.print("/");
+    CONSOLE_PORT.print(bus.bus_errors);
+    CONSOLE_PORT.print("/");
+    CONSOLE_PORT.print(bus.timeouts);
+    CONSOLE_PORT.print("/");
+    CONSOLE_PORT.print(bus.bus_clears);
+    CONSOLE_PORT.print(F(" i2c_block_us="));
+    CONSOLE_PORT.println(bus.max_block_us);
+  }
+  return OK;
+}
+
+static int doCTSignals(char *arg) {
+  if (arg) {
+    if (EQ(arg, "reset")) {
+      signal_capture_reset();
+      return ok();
+    }
+
+    if (EQ(arg, "rate")) {
+      char *msstr = next_arg();
+      int ms;
+      if (!msstr)
+        return EUSAGE;
+      if (!parseInt(msstr, &ms) || ms < 0 || ms > 60000)
+        return EARG;
+      signal_capture_request(SIGNAL_CAPTURE_CONSOLE, ms, false);
+      return ok();
+    }
+
+    if (!EQ(arg, "dump"))
+      return EARG;
+
+    if (!quiet) {
+      uint8_t len = signal_capture_history_length();
+      CONSOLE_PORT.print(F("ct_signals: "));
+      CONSOLE_PORT.println(len);
+      for (uint8_t i = 0; i < len; ++i) {
+        const int16_t *frame = signal_capture_history_frame(i);
+        for (int ch = 0; ch < CAP_TOUCH_CHANNEL_COUNT; ++ch) {
+          print_hex_byte((uint16_t)frame[ch] >> 8);
+          print_hex_byte(frame[ch] & 0xFF);
+        }
+        CONSOLE_PORT.println("");
+      }
+    }
+    return OK;
+  }
+
+  if (!quiet) {
+    CONSOLE_PORT.print(F("ct_signals: rate="));
+    CONSOLE_PORT.print(signal_capture_get_interval());
+    CONSOLE_PORT.print(F(" frames="));
+    CONSOLE_PORT.print(signal_capture_frames());
+    CONSOLE_PORT.print(F(" slider_frames="));
+    CONSOLE_PORT.println(signal_capture_slider_frames());
+
+    const cap_touch_raw_t *raw = signal_capture_latest();
+    for (int ch = 0; ch < CAP_TOUCH_CHANNEL_COUNT; ++ch) {
+      signal_stats_t st;
+      signal_capture_get_stats(ch, &st);
+      print_channel_name(ch);
+      CONSOLE_PORT.print(F(": sig="));
+      CONSOLE_PORT.print(raw->signal[ch]);
+      CONSOLE_PORT.print(F(" ref="));
+      CONSOLE_PORT.print(raw->reference[ch]);
+      CONSOLE_PORT.print(F(" delta="));
+      CONSOLE_PORT.print(signal_capture_delta(ch));
+      CONSOLE_PORT.print(F(" mean="));
+      CONSOLE_PORT.print(st.mean);
+      CONSOLE_PORT.print(F(" var="));
+      CONSOLE_PORT.print(st.variance);
+      CONSOLE_PORT.print(F(" p2p="));
+      CONSOLE_PORT.println(st.max - st.min);
+    }
+  }
+  return OK;
+}
+
+static const char* tune_state_names[] = {
+  "idle",
+  "touch",
+  "sweep",
+  "verify",
+  "done",
+  "failed"
+};
+
+static int doCTTopology(char *arg) {
+  cap_touch_topology_t topology;
+  cap_touch_get_topology(&topology);
+
+  if (!arg) {
+    if (!quiet) {
+      CONSOLE_PORT.print(F("ct_topology: slider="));
+      CONSOLE_PORT.print(slider_mode_names[topology.slider]);
+      for (uint8_t c = 0; c < CAP_TOUCH_CONTROLLER_COUNT; ++c) {
+        CONSOLE_PORT.print(' ');
+        CONSOLE_PORT.print(c);
+        CONSOLE_PORT.print(':');
+        for (uint8_t k = 0; k < CAP_TOUCH_KEYS_PER_CONTROLLER; ++k) {
+          print_hex_byte(topology.key_pad[c][k]);
+        }
+      }
+      CONSOLE_PORT.println("");
+    }
+    return OK;
+  }
+
+  char *val = next_arg();
+  if (!val) {
+    return EUSAGE;
+  }
+
+  if (EQ(arg, "slider")) {
+    int mode;
+    for (mode = 0; mode <= CAP_TOUCH_SLIDER_WHEEL; ++mode) {
+      if (EQ(val, slider_mode_names[mode])) {
+        break;
+      }
+    }
+    if (mode > CAP_TOUCH_SLIDER_WHEEL) {
+      return EARG;
+    }
+    topology.slider = mode;
+  } else {
+    int ctl;
+    if (!parseInt(arg, &ctl) || ctl < 0 || ctl >= CAP_TOUCH_CONTROLLER_COUNT) {
+      return EARG;
+    }
+    if (parseHex(topology.key_pad[ctl], val, CAP_TOUCH_KEYS_PER_CONTROLLER) < 0) {
+      return EARG;
+    }
+  }
+
+  if (!cap_touch_set_topology(&topology)) {
+    return EARG;
+  }
   return ok();
 }
 
+static int doCTTune(char *arg) {
+  if (!arg) {
+    auto_tune_start();
+    return ok();
+  }
+
+  if (EQ(arg, "abort")) {
+    auto_tune_abort();
+    return ok();
+  }
+
+  if (!EQ(arg, "status"))
+    return EARG;
+
+  if (!quiet) {
+    uint8_t state = auto_tune_state();
+    CONSOLE_PORT.print(F("ct_tune: "));
+    CONSOLE_PORT.print(tune_state_names[state]);
+    if (state == AUTO_TUNE_TOUCH || state == AUTO_TUNE_SWEEP || state == AUTO_TUNE_VERIFY) {
+      CONSOLE_PORT.print(" ");
+      CONSOLE_PORT.print(auto_tune_progress());
+      CONSOLE_PORT.print("/");
+      CONSOLE_PORT.print(auto_tune_steps());
+    }
+    if (state != AUTO_TUNE_DONE) {
+      CONSOLE_PORT.println("");
+      return OK;
+    }
+
+    CONSOLE_PORT.print(F(" charge="));
+    CONSOLE_PORT.println(auto_tune_charge_time());
+    for (int i = 0; i < CAP_TOUCH_PAD_COUNT; ++i) {
+      auto_tune_result_t r;
+      auto_tune_get_result(i, &r);
+      print_channel_name(i);
+      CONSOLE_PORT.print(F(": ps=0x"));
+      print_hex_byte(r.pulse_scale);
+      CONSOLE_PORT.print(F(" thr="));
+      CONSOLE_PORT.print(r.threshold);
+      CONSOLE_PORT.print(F(" snr="));
+      CONSOLE_PORT.print(r.snr_x10 / 10);
+      CONSOLE_PORT.print(".");
+      CONSOLE_PORT.print(r.snr_x10 % 10);
+      CONSOLE_PORT.print(F(" delta="));
+      CONSOLE_PORT.println(r.delta);
+    }
+  }
+  return OK;
+}
+
 static int doHello(char *ignore) {
   if (!quiet) {
     CONSOLE_PORT.println(F("hello! PipTouch (hw=" PT_HW_VERSION_STR ";fw=" PT_FW_VERSION_STR ")"));  
+    if (stall_monitor_watchdog_reset()) {
+      stall_record_t r;
+      bool previous;
+      stall_monitor_get_record(&r, &previous);
+      CONSOLE_PORT.print(F("hello: watchdog reset, stalled in "));
+      print_stall_where(&r);
+      CONSOLE_PORT.println(F(" - see 'stall'"));
+    }
   }
   return OK;
 }
@@ -526,6 +1466,41 @@ static int doIdent(char *val) {
   return ok();
 }
 
+static int doLatency(char *arg) {
+  if (arg) {
+    if (!EQ(arg, "reset"))
+      return EARG;
+    latency_reset();
+    return ok();
+  }
+
+  if (!quiet) {
+    for (uint8_t m = 0; m < MODE_COUNT; ++m) {
+      latency_stats_t stats;
+      latency_get_stats(m, &stats);
+      CONSOLE_PORT.print(F("latency: "));
+      CONSOLE_PORT.print(mode_names[m]);
+      CONSOLE_PORT.print(F(" n="));
+      CONSOLE_PORT.print(stats.count);
+      CONSOLE_PORT.print(F(" mean_us="));
+      CONSOLE_PORT.print(stats.count ? stats.total_us / stats.count : 0);
+      CONSOLE_PORT.print(F(" max_us="));
+      CONSOLE_PORT.print(stats.max_us);
+      CONSOLE_PORT.print(F(" hist="));
+      for (uint8_t b = 0; b < LATENCY_BUCKETS; ++b) {
+        if (b) {
+          CONSOLE_PORT.print("/");
+        }
+        CONSOLE_PORT.print(stats.buckets[b]);
+      }
+      CONSOLE_PORT.println("");
+    }
+    CONSOLE_PORT.print(F("latency: dropped="));
+    CONSOLE_PORT.println(latency_dropped());
+  }
+  return OK;
+}
+
 static int doLED(char *range) {
   char *color;
   uint8_t mask, r, g, b;
@@ -588,11 +1563,24 @@ static int doMIDI(char *str_channel) {
       CONSOLE_PORT.print(F("midi: "));
       CONSOLE_PORT.print(settings_get_midi_channel()+1);
       CONSOLE_PORT.print(" ");
-      CONSOLE_PORT.println(settings_get_midi_controller());  
+      CONSOLE_PORT.print(settings_get_midi_controller());  
+      CONSOLE_PORT.print(F(" gestures="));
+      CONSOLE_PORT.println(settings_are_midi_gestures_enabled() ? "on" : "off");
     }
     return OK;
   }
 
+  if (EQ(str_channel, "gestures")) {
+    char *val = next_arg();
+    bool on;
+    if (!val)
+      return EUSAGE;
+    if (!parseBool(val, &on))
+      return EARG;
+    settings_set_midi_gestures_enabled(on);
+    return ok();
+  }
+
   char *str_controller = next_arg();
   if (!str_controller)
     return EUSAGE;
@@ -629,14 +1617,170 @@ static int doMode(char *mode) {
 }
 
 static int doSave(char *ignore) {
-  defaults_v1 to_save;
-  settings_export(&to_save);
-  cap_touch_read_config(&to_save.ct);
-  to_save.startup_mode = mode_selection_get();
-  defaults_save(&to_save);
+  settings_save_defaults();
+  return ok();
+}
+
+static int doSched(char *arg) {
+  if (arg) {
+    if (!EQ(arg, "reset"))
+      return EARG;
+    scheduler_reset_stats();
+    return ok();
+  }
+
+  if (!quiet) {
+    for (uint8_t i = 0; i < SCHEDULER_STAGE_COUNT; ++i) {
+      scheduler_stats_t stats;
+      scheduler_get_stats(i, &stats);
+      CONSOLE_PORT.print(F("sched: "));
+      CONSOLE_PORT.print(scheduler_stage_name(i));
+      CONSOLE_PORT.print(F(" period="));
+      CONSOLE_PORT.print(scheduler_stage_period(i));
+      CONSOLE_PORT.print(F(" runs="));
+      CONSOLE_PORT.print(stats.runs);
+      CONSOLE_PORT.print(F(" overruns="));
+      CONSOLE_PORT.print(stats.overruns);
+      CONSOLE_PORT.print(F(" late="));
+      CONSOLE_PORT.print(stats.max_late);
+      CONSOLE_PORT.print(F(" max_us="));
+      CONSOLE_PORT.println(stats.max_us);
+    }
+  }
+  return OK;
+}
+
+static int doSlider(char *str_smoothing) {
+  if (!str_smoothing) {
+    if (!quiet) {
+      slider_filter_config_t cfg;
+      slider_filter_stats_t stats;
+      slider_filter_get_config(&cfg);
+      slider_filter_get_stats(&stats);
+      CONSOLE_PORT.print(F("slider: "));
+      CONSOLE_PORT.print(cfg.smoothing);
+      CONSOLE_PORT.print(" ");
+      CONSOLE_PORT.print(cfg.deadband);
+      CONSOLE_PORT.print(" ");
+      CONSOLE_PORT.print(cfg.hysteresis);
+      CONSOLE_PORT.print(F(" changes="));
+      CONSOLE_PORT.print(stats.changes);
+      CONSOLE_PORT.print(F(" suppressed="));
+      CONSOLE_PORT.print(stats.suppressed);
+      CONSOLE_PORT.print(F(" per_sec="));
+      CONSOLE_PORT.print(stats.suppressed_per_sec);
+      CONSOLE_PORT.print(F(" engine="));
+      CONSOLE_PORT.println(slider_engine_is_enabled() ? "on" : "off");
+    }
+    return OK;
+  }
+
+  if (EQ(str_smoothing, "reset")) {
+    slider_filter_reset_stats();
+    return ok();
+  }
+
+  if (EQ(str_smoothing, "engine")) {
+    char *val = next_arg();
+    bool on;
+    if (!val) {
+      if (!quiet) {
+        CONSOLE_PORT.print(F("slider: engine="));
+        CONSOLE_PORT.println(slider_engine_is_enabled() ? "on" : "off");
+      }
+      return OK;
+    }
+    if (!parseBool(val, &on))
+      return EARG;
+    slider_engine_set_enabled(on);
+    return ok();
+  }
+
+  char *str_deadband = next_arg();
+  char *str_hysteresis = next_arg();
+  if (!str_deadband || !str_hysteresis)
+    return EUSAGE;
+
+  int smoothing, deadband, hysteresis;
+  if (!parseInt(str_smoothing, &smoothing) || !parseInt(str_deadband, &deadband) || !parseInt(str_hysteresis, &hysteresis))
+    return EARG;
+
+  if (smoothing < 0 || smoothing > SLIDER_FILTER_MAX_SMOOTHING || deadband < 0 || deadband > 255 || hysteresis < 0 || hysteresis > 255)
+    return EARG;
+
+  slider_filter_config_t cfg = { (uint8_t)smoothing, (uint8_t)deadband, (uint8_t)hysteresis };
+  slider_filter_set_config(&cfg);
+
   return ok();
 }
 
+static int doStall(char *arg) {
+  if (arg) {
+    if (!EQ(arg, "reset"))
+      return EARG;
+    stall_monitor_reset();
+    return ok();
+  }
+
+  if (!quiet) {
+    for (uint8_t i = 0; i < SCHEDULER_STAGE_COUNT; ++i) {
+      CONSOLE_PORT.print(F("stall: "));
+      CONSOLE_PORT.print(scheduler_stage_name(i));
+      CONSOLE_PORT.print(F(" deadline="));
+      CONSOLE_PORT.print(stall_monitor_deadline(i));
+      CONSOLE_PORT.print(F(" overruns="));
+      CONSOLE_PORT.println(stall_monitor_overruns(i));
+    }
+
+    stall_record_t r;
+    bool previous;
+    stall_monitor_get_record(&r, &previous);
+    CONSOLE_PORT.print(F("stall: last="));
+    if (r.kind == STALL_NONE) {
+      CONSOLE_PORT.println(F("none"));
+      return OK;
+    }
+    CONSOLE_PORT.print(r.kind == STALL_WATCHDOG ? F("watchdog") : F("overrun"));
+    CONSOLE_PORT.print(F(" in="));
+    print_stall_where(&r);
+    CONSOLE_PORT.print(F(" us="));
+    CONSOLE_PORT.print(r.us);
+    CONSOLE_PORT.print(F(" at_ms="));
+    CONSOLE_PORT.print(r.at_ms);
+    CONSOLE_PORT.println(previous ? F(" (before reset)") : F(""));
+  }
+  return OK;
+}
+
+#if PT_PROFILING
+static int doStats(char *arg) {
+  if (arg) {
+    if (!EQ(arg, "reset"))
+      return EARG;
+    profiler_reset();
+    return ok();
+  }
+
+  if (!quiet) {
+    for (uint8_t i = 0; i < PROFILE_COUNT; ++i) {
+      profile_stats_t stats;
+      profiler_get_stats(i, &stats);
+      CONSOLE_PORT.print(F("stats: "));
+      CONSOLE_PORT.print(profiler_name(i));
+      CONSOLE_PORT.print(F(" calls="));
+      CONSOLE_PORT.print(stats.calls);
+      CONSOLE_PORT.print(F(" cycles="));
+      CONSOLE_PORT.print(stats.min);
+      CONSOLE_PORT.print("/");
+      CONSOLE_PORT.print(stats.calls ? (stats.total / stats.calls) * SCHEDULER_PRESCALE : 0);
+      CONSOLE_PORT.print("/");
+      CONSOLE_PORT.println(stats.max);
+    }
+  }
+  return OK;
+}
+#endif
+
 static int doTrack(char *val) {
   bool on;
 
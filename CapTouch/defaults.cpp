@@ -1,6 +1,38 @@
 #include "defaults.h"
 
 #include <avr/eeprom.h>
+#include <stddef.h>
+#include <string.h>
+#include "stall_monitor.h"
+
+// Erase and write, per byte that changes
+#define EEPROM_WRITE_US   3400
+
+// Version 1 had 8 pads and nothing after ct
+#define V1_PAD_COUNT      8
+
+typedef struct __attribute__ ((packed)) defaults_v1 {
+  uint8_t                 settings[offsetof(defaults_t, ct)];
+  uint8_t                 ct_head[offsetof(cap_touch_config_t, key_detect_threshold)];
+  uint8_t                 key_detect_threshold[V1_PAD_COUNT];
+  uint8_t                 key_control[V1_PAD_COUNT];
+  uint8_t                 key_pulse_scale[V1_PAD_COUNT];
+} defaults_v1_t;
+
+// The old pads keep their settings; the new ones get the chip defaults
+static void load_v1(defaults_t *values) {
+  defaults_v1_t old;
+  eeprom_read_block(&old, 4, sizeof(old));
+
+  memcpy(values, old.settings, sizeof(old.settings));
+  memcpy(&values->ct, old.ct_head, sizeof(old.ct_head));
+  for (int i = 0; i < CAP_TOUCH_PAD_COUNT; ++i) {
+    bool had = i < V1_PAD_COUNT;
+    values->ct.key_detect_threshold[i] = had ? old.key_detect_threshold[i] : 10;
+    values->ct.key_control[i] = had ? old.key_control[i] : 0;
+    values->ct.key_pulse_scale[i] = had ? old.key_pulse_scale[i] : 0;
+  }
+}
 
 static int get_version() {
   uint8_t b1 = eeprom_read_byte(0);
@@ -23,18 +55,22 @@ static int write_defaults(uint8_t version, void *data, int len) {
   eeprom_update_byte(3, version);
 }
 
-bool defaults_init(defaults_v1 *values) {
+bool defaults_init(defaults_t *values) {
   int version = get_version();
   if (version == 1) {
-    eeprom_read_block(values, 4, sizeof(defaults_v1));
+    load_v1(values);
+    return true;
+  } else if (version == DEFAULTS_VERSION) {
+    eeprom_read_block(values, 4, sizeof(defaults_t));
     return true;
   } else {
     return false;
   }
 }
 
-int defaults_save(const defaults_v1 *values) {
-  write_defaults(1, values, sizeof(defaults_v1));
+int defaults_save(const defaults_t *values) {
+  stall_monitor_expect((uint32_t)(sizeof(defaults_t) + 4) * EEPROM_WRITE_US);
+  write_defaults(DEFAULTS_VERSION, values, sizeof(defaults_t));
   return 0;
 }
 
@@ -3,20 +3,38 @@
 
 #include "Arduino.h"
 #include "cap_touch.h"
+#include "slider_filter.h"
+#include "lp_governor.h"
+#include "proximity.h"
+#include "key_filter.h"
+#include "drift_monitor.h"
 
-struct __attribute__ ((packed)) defaults_v1 {
-    uint8_t             startup_mode;
-    uint8_t             led_tracking_enabled;
-    uint8_t             midi_channel;
-    uint8_t             midi_controller;
-    cap_touch_config_t  ct;
-};
+// Version 1 is the original firmware's layout: the four settings bytes and
+// ct with 8 pads. Version 2 widens ct to CAP_TOUCH_PAD_COUNT pads and adds
+// everything after it. Version 1 is converted on load (see defaults.cpp);
+// the fields it doesn't have are left as the caller initialised them.
+#define DEFAULTS_VERSION  2
+
+typedef struct __attribute__ ((packed)) defaults {
+    uint8_t                 startup_mode;
+    uint8_t                 led_tracking_enabled;
+    uint8_t                 midi_channel;
+    uint8_t                 midi_controller;
+    cap_touch_config_t      ct;
+    slider_filter_config_t  slider_filter;
+    lp_governor_config_t    lp_governor;
+    cap_touch_topology_t    topology;
+    proximity_config_t      proximity;
+    key_filter_config_t     key_filter;
+    uint8_t                 midi_gestures;
+    drift_monitor_config_t  drift_monitor;
+} defaults_t;
 
 #define DEFAULTS_LOADED   1
 #define DEFAULTS_WRITTEN  2
 
-bool defaults_init(defaults_v1 *values);
-int defaults_save(const defaults_v1 *values);
+bool defaults_init(defaults_t *values);
+int defaults_save(const defaults_t *values);
 void defaults_clear();
 
 #endif
@@ -0,0 +1,176 @@
+#include "drift_monitor.h"
+
+#include <Arduino.h>
+#include "signal_capture.h"
+
+static bool enabled = DRIFT_MONITOR_DEFAULT_ENABLED;
+static uint16_t stuck_s = DRIFT_MONITOR_DEFAULT_STUCK_S;
+static uint16_t drift_limit = DRIFT_MONITOR_DEFAULT_DRIFT_LIMIT;
+
+static drift_monitor_stats_t stats;
+
+// When each pad was last seen untouched
+static unsigned long released_at[CAP_TOUCH_PAD_COUNT];
+
+// References captured on the first frame after calibration
+static uint16_t baseline[CAP_TOUCH_CHANNEL_COUNT];
+static bool baseline_valid;
+
+// Consecutive frames each channel's delta has been below -drift_limit
+static uint8_t negative_frames[CAP_TOUCH_CHANNEL_COUNT];
+#define NEGATIVE_FRAMES   4
+
+static uint32_t last_frame;
+static unsigned long last_recal_at;
+static bool recalled;
+
+static uint8_t channel_mask(uint8_t channel) {
+  // Slider keys are on the first controller
+  uint8_t ctl = (channel < CAP_TOUCH_PAD_COUNT) ? cap_touch_pad_controller(channel) : 0;
+  return (ctl == CAP_TOUCH_KEY_DISABLED) ? 0 : (1 << ctl);
+}
+
+static void start_capture() {
+  signal_capture_request(SIGNAL_CAPTURE_DRIFT, DRIFT_MONITOR_INTERVAL_MS, false);
+}
+
+void drift_monitor_init() {
+  unsigned long now = millis();
+  for (int i = 0; i < CAP_TOUCH_PAD_COUNT; ++i) {
+    released_at[i] = now;
+  }
+  baseline_valid = false;
+  last_frame = signal_capture_frames();
+  if (enabled) {
+    start_capture();
+  }
+}
+
+void drift_monitor_set_enabled(bool on) {
+  enabled = on;
+  if (on) {
+    drift_monitor_init();
+  } else {
+    signal_capture_request(SIGNAL_CAPTURE_DRIFT, 0, false);
+  }
+}
+
+bool drift_monitor_is_enabled() {
+  return enabled;
+}
+
+void drift_monitor_set_limits(uint16_t new_stuck_s, uint16_t new_drift_limit) {
+  stuck_s = new_stuck_s;
+  drift_limit = new_drift_limit;
+}
+
+void drift_monitor_get_limits(uint16_t *out_stuck_s, uint16_t *out_drift_limit) {
+  *out_stuck_s = stuck_s;
+  *out_drift_limit = drift_limit;
+}
+
+void drift_monitor_get_config(drift_monitor_config_t *out) {
+  out->enabled = enabled;
+  out->stuck_s = stuck_s;
+  out->drift_limit = drift_limit;
+}
+
+void drift_monitor_set_config(const drift_monitor_config_t *in) {
+  drift_monitor_set_limits(in->stuck_s, in->drift_limit);
+  drift_monitor_set_enabled(in->enabled);
+}
+
+static void check_stuck(cap_touch_buttons_t buttons, unsigned long now, uint8_t *mask) {
+  for (int i = 0; i < CAP_TOUCH_PAD_COUNT; ++i) {
+    if (!(buttons & CAP_TOUCH_PAD_BIT(i))) {
+      released_at[i] = now;
+    } else if (stuck_s && (now - released_at[i]) >= stuck_s * 1000UL) {
+      stats.stuck[i]++;
+      released_at[i] = now;
+      *mask |= channel_mask(i);
+    }
+  }
+}
+
+static void check_drift(uint8_t *mask) {
+  const cap_touch_raw_t *raw = signal_capture_latest();
+
+  if (!baseline_valid) {
+    memcpy(baseline, raw->reference, sizeof(baseline));
+    memset(negative_frames, 0, sizeof(negative_frames));
+    baseline_valid = true;
+    return;
+  }
+
+  for (int i = 0; i < CAP_TOUCH_CHANNEL_COUNT; ++i) {
+    bool drifted = abs((int32_t)raw->reference[i] - baseline[i]) > drift_limit;
+
+    if (signal_capture_delta(i) < -(int16_t)drift_limit) {
+      if (negative_frames[i] < NEGATIVE_FRAMES) {
+        negative_frames[i]++;
+      }
+    } else {
+      negative_frames[i] = 0;
+    }
+    if (negative_frames[i] >= NEGATIVE_FRAMES) {
+      drifted = true;
+    }
+
+    if (drifted) {
+      stats.drift[i]++;
+      *mask |= channel_mask(i);
+    }
+  }
+}
+
+void drift_monitor_update(const cap_touch_state_t *state) {
+  if (!enabled) {
+    return;
+  }
+
+  // Results only mean something between calibrations
+  if (cap_touch_reset_state() != CAP_TOUCH_RESET_READY || cap_touch_cal_state() == CAP_TOUCH_CAL_RUNNING) {
+    baseline_valid = false;
+    return;
+  }
+
+  unsigned long now = millis();
+  uint32_t frames = signal_capture_frames();
+  bool new_frame = frames != last_frame;
+  last_frame = frames;
+
+  uint8_t mask = 0;
+  if (recalled && (now - last_recal_at) < DRIFT_MONITOR_HOLDOFF_MS) {
+    // Keep tracking releases so a pad that is let go in the meantime
+    // doesn't count as stuck afterwards, and take the new baseline
+    for (int i = 0; i < CAP_TOUCH_PAD_COUNT; ++i) {
+      if (!(state->buttons & CAP_TOUCH_PAD_BIT(i))) {
+        released_at[i] = now;
+      }
+    }
+    if (new_frame && !baseline_valid) {
+      check_drift(&mask);
+    }
+    return;
+  }
+
+  check_stuck(state->buttons, now, &mask);
+  if (new_frame) {
+    check_drift(&mask);
+  }
+
+  if (mask) {
+    recalled = true;
+    last_recal_at = now;
+    stats.recals++;
+    cap_touch_recal_controllers(mask);
+  }
+}
+
+void drift_monitor_get_stats(drift_monitor_stats_t *out) {
+  *out = stats;
+}
+
+void drift_monitor_reset_stats() {
+  memset(&stats, 0, sizeof(stats));
+}
@@ -0,0 +1,59 @@
+#ifndef DRIFT_MONITOR_H
+#define DRIFT_MONITOR_H
+
+#include <stdint.h>
+#include "cap_touch.h"
+
+// Drift monitor
+// -------------
+// Watches for keys that need recalibrating and recalibrates the controller
+// they're on in the background:
+//
+// stuck : a pad reported touched for longer than stuck_s (a key latched on
+//         by drift, or a finger on it at power-up)
+// drift : a channel's reference has moved more than drift_limit counts from
+//         where it was after the last calibration, or its delta has stayed
+//         below -drift_limit (reference too low; touches would be missed)
+//
+// Reference/signal data comes from signal capture, which runs at
+// DRIFT_MONITOR_INTERVAL_MS or faster while the monitor is on.
+// Automatic recalibrations are at least DRIFT_MONITOR_HOLDOFF_MS apart so a
+// real problem can't turn into a recalibration loop.
+//
+// Off by default, and stuck detection with it: a held note or modifier is
+// a legitimate long touch, and the chip's own drift compensation moves
+// references too, so both want setting for the installation.
+
+#define DRIFT_MONITOR_INTERVAL_MS     1000
+#define DRIFT_MONITOR_HOLDOFF_MS      30000
+
+#define DRIFT_MONITOR_DEFAULT_ENABLED       0
+#define DRIFT_MONITOR_DEFAULT_STUCK_S       0
+#define DRIFT_MONITOR_DEFAULT_DRIFT_LIMIT   100
+
+typedef struct __attribute__ ((packed)) drift_monitor_config {
+  uint8_t enabled;
+  uint16_t stuck_s;       // 0 = never
+  uint16_t drift_limit;
+} drift_monitor_config_t;
+
+typedef struct drift_monitor_stats {
+  uint16_t stuck[CAP_TOUCH_PAD_COUNT];
+  uint16_t drift[CAP_TOUCH_CHANNEL_COUNT];
+  uint16_t recals;
+} drift_monitor_stats_t;
+
+void drift_monitor_init();
+void drift_monitor_set_enabled(bool enabled);
+bool drift_monitor_is_enabled();
+void drift_monitor_set_limits(uint16_t stuck_s, uint16_t drift_limit);
+void drift_monitor_get_limits(uint16_t *stuck_s, uint16_t *drift_limit);
+void drift_monitor_get_config(drift_monitor_config_t *out);
+void drift_monitor_set_config(const drift_monitor_config_t *in);
+
+void drift_monitor_update(const cap_touch_state_t *state);
+
+void drift_monitor_get_stats(drift_monitor_stats_t *out);
+void drift_monitor_reset_stats();
+
+#endif
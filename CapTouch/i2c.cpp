@@ -0,0 +1,233 @@
+#include "i2c.h"
+
+#include <Arduino.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+
+#define TW_START        0x08
+#define TW_REP_START    0x10
+#define TW_MT_SLA_ACK   0x18
+#define TW_MT_SLA_NACK  0x20
+#define TW_MT_DATA_ACK  0x28
+#define TW_MT_DATA_NACK 0x30
+#define TW_ARB_LOST     0x38
+#define TW_MR_SLA_ACK   0x40
+#define TW_MR_SLA_NACK  0x48
+#define TW_MR_DATA_ACK  0x50
+#define TW_MR_DATA_NACK 0x58
+
+#define TWCR_START      ((1 << TWINT) | (1 << TWSTA) | (1 << TWEN) | (1 << TWIE))
+#define TWCR_NEXT       ((1 << TWINT) | (1 << TWEN) | (1 << TWIE))
+#define TWCR_NEXT_ACK   (TWCR_NEXT | (1 << TWEA))
+#define TWCR_STOP       ((1 << TWINT) | (1 << TWSTO) | (1 << TWEN))
+
+static i2c_job_t *queue[I2C_QUEUE_SIZE];
+static uint8_t q_head, q_count;
+static i2c_job_t * volatile active;
+static unsigned long active_started_at;
+static uint8_t pos;
+static bool reg_sent;
+static i2c_stats_t stats;
+
+// Must be called from the TWI ISR or with interrupts disabled
+static void start_next() {
+  if (q_count == 0) {
+    active = NULL;
+    return;
+  }
+  active = queue[q_head];
+  q_head = (q_head + 1) % I2C_QUEUE_SIZE;
+  q_count--;
+
+  active->status = I2C_BUSY;
+  active_started_at = micros();
+  pos = 0;
+  reg_sent = false;
+  stats.transactions++;
+  TWCR = TWCR_START;
+}
+
+static void finish(uint8_t status) {
+  TWCR = TWCR_STOP;
+  // STOP takes a bit time to go out. Bounded in case the bus is stuck; the
+  // next job will then time out and trigger a bus clear.
+  for (uint16_t i = 0; (TWCR & (1 << TWSTO)) && i < 1000; ++i) {
+    /* spin */
+  }
+
+  i2c_job_t *job = active;
+  job->status = status;
+  if (job->done) {
+    job->done(job);
+  }
+
+  start_next();
+}
+
+void i2c_init() {
+  // Internal pull-ups on SCL/SDA, as Wire does
+  PORTD |= (1 << 0) | (1 << 1);
+
+  TWSR = 0;
+  TWBR = ((F_CPU / I2C_CLOCK_HZ) - 16) / 2;
+  TWCR = (1 << TWEN);
+}
+
+// Bit-bang SCL (PD0) until a slave stuck mid-byte releases SDA (PD1), then
+// generate a STOP. Lines are only ever released (input + pull-up) or driven
+// low, never driven high.
+static void bus_clear() {
+  TWCR = 0;
+  DDRD &= ~((1 << 0) | (1 << 1));
+  PORTD |= (1 << 0) | (1 << 1);
+
+  for (uint8_t i = 0; i < 9 && !(PIND & (1 << 1)); ++i) {
+    PORTD &= ~(1 << 0);
+    DDRD |= (1 << 0);
+    delayMicroseconds(5);
+    DDRD &= ~(1 << 0);
+    PORTD |= (1 << 0);
+    delayMicroseconds(5);
+  }
+
+  // STOP: SDA low -> high while SCL is high
+  PORTD &= ~(1 << 1);
+  DDRD |= (1 << 1);
+  delayMicroseconds(5);
+  DDRD &= ~(1 << 1);
+  PORTD |= (1 << 1);
+  delayMicroseconds(5);
+
+  stats.bus_clears++;
+  i2c_init();
+}
+
+void i2c_poll() {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    i2c_job_t *job = active;
+    if (job && (micros() - active_started_at) > I2C_TIMEOUT_US(job->len)) {
+      stats.timeouts++;
+      bus_clear();
+      job->status = I2C_ERR_TIMEOUT;
+      if (job->done) {
+        job->done(job);
+      }
+      start_next();
+    }
+  }
+}
+
+bool i2c_submit(i2c_job_t *job) {
+  bool queued = false;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    if (q_count < I2C_QUEUE_SIZE && !I2C_PENDING(job) && job->len > 0) {
+      job->status = I2C_QUEUED;
+      queue[(q_head + q_count) % I2C_QUEUE_SIZE] = job;
+      q_count++;
+      if (!active) {
+        start_next();
+      }
+      queued = true;
+    }
+  }
+  return queued;
+}
+
+static void note_block_time(unsigned long start) {
+  unsigned long waited = micros() - start;
+  if (waited > stats.max_block_us) {
+    stats.max_block_us = (waited > 0xFFFF) ? 0xFFFF : waited;
+  }
+}
+
+uint8_t i2c_wait(i2c_job_t *job) {
+  unsigned long start = micros();
+  while (I2C_PENDING(job)) {
+    i2c_poll();
+  }
+  note_block_time(start);
+  return job->status;
+}
+
+static uint8_t submit_and_wait(i2c_job_t *job) {
+  unsigned long start = micros();
+  while (!i2c_submit(job)) {
+    // Queue full; jobs ahead of us are bounded so a slot will free up
+    i2c_poll();
+  }
+  note_block_time(start);
+  return i2c_wait(job);
+}
+
+uint8_t i2c_read(uint8_t addr, uint8_t reg, uint8_t *buf, uint8_t len) {
+  i2c_job_t job = { addr, reg, I2C_READ, len, buf, NULL, I2C_IDLE };
+  return submit_and_wait(&job);
+}
+
+uint8_t i2c_write(uint8_t addr, uint8_t reg, const uint8_t *buf, uint8_t len) {
+  i2c_job_t job = { addr, reg, I2C_WRITE, len, (uint8_t*)buf, NULL, I2C_IDLE };
+  return submit_and_wait(&job);
+}
+
+void i2c_get_stats(i2c_stats_t *out) {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    *out = stats;
+  }
+}
+
+void i2c_reset_stats() {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    memset(&stats, 0, sizeof(stats));
+  }
+}
+
+// Any NACK, arbitration loss or unexpected status ends the job with an
+// error and moves straight on to the next one; only a job that stops
+// interrupting altogether is left to i2c_poll()'s timeout
+ISR(TWI_vect) {
+  i2c_job_t *job = active;
+  switch (TWSR & 0xF8) {
+    case TW_START:
+    case TW_REP_START:
+      TWDR = (job->addr << 1) | ((job->dir == I2C_READ && reg_sent) ? 1 : 0);
+      TWCR = TWCR_NEXT;
+      break;
+    case TW_MT_SLA_ACK:
+      TWDR = job->reg;
+      reg_sent = true;
+      TWCR = TWCR_NEXT;
+      break;
+    case TW_MT_DATA_ACK:
+      if (job->dir == I2C_READ) {
+        TWCR = TWCR_START;
+      } else if (pos < job->len) {
+        TWDR = job->buf[pos++];
+        TWCR = TWCR_NEXT;
+      } else {
+        finish(I2C_DONE);
+      }
+      break;
+    case TW_MR_SLA_ACK:
+      TWCR = (job->len > 1) ? TWCR_NEXT_ACK : TWCR_NEXT;
+      break;
+    case TW_MR_DATA_ACK:
+      job->buf[pos++] = TWDR;
+      TWCR = (pos + 1 < job->len) ? TWCR_NEXT_ACK : TWCR_NEXT;
+      break;
+    case TW_MR_DATA_NACK:
+      job->buf[pos++] = TWDR;
+      finish(I2C_DONE);
+      break;
+    case TW_MT_SLA_NACK:
+    case TW_MT_DATA_NACK:
+    case TW_MR_SLA_NACK:
+      stats.nacks++;
+      finish(I2C_ERR_NACK);
+      break;
+    case TW_ARB_LOST:
+    default:
+      stats.bus_errors++;
+      finish(I2C_ERR_BUS);
+      break;
+  }
+}
@@ -0,0 +1,73 @@
+#ifndef I2C_H
+#define I2C_H
+
+#include <stdint.h>
+
+// Interrupt-driven TWI master
+// ---------------------------
+// Transfers are described by an i2c_job_t and queued with i2c_submit(); the
+// TWI interrupt works through the queue without blocking the main loop.
+// Completion is signalled by job->status leaving I2C_QUEUED/I2C_BUSY, and
+// by job->done (if set), which is called from interrupt context.
+//
+// Jobs are register-oriented: a write sends <reg> followed by len bytes from
+// buf; a read sends <reg> then a repeated start and reads len bytes into buf.
+//
+// Every job has a time budget proportional to its length. i2c_poll() (called
+// from the blocking helpers and regularly from the main loop) aborts a job
+// that overruns it, clears the bus by clocking SCL until the slave releases
+// SDA, and moves on to the next job, so no caller can be stalled for longer
+// than the budgets of the jobs ahead of it.
+
+#define I2C_CLOCK_HZ      100000
+// Room for a scan, a config flush and a raw read per touch controller
+#define I2C_QUEUE_SIZE    8
+
+// ~90us per byte at 100kHz; allow twice that plus address/register bytes
+#define I2C_TIMEOUT_US(len) (1000 + ((uint32_t)(len) + 3) * 180)
+
+#define I2C_WRITE         0
+#define I2C_READ          1
+
+#define I2C_IDLE          0
+#define I2C_QUEUED        1
+#define I2C_BUSY          2
+#define I2C_DONE          3
+#define I2C_ERR_NACK      4
+#define I2C_ERR_BUS       5
+#define I2C_ERR_TIMEOUT   6
+
+#define I2C_PENDING(job)  ((job)->status == I2C_QUEUED || (job)->status == I2C_BUSY)
+
+typedef struct i2c_job {
+  uint8_t addr;
+  uint8_t reg;
+  uint8_t dir;
+  uint8_t len;
+  uint8_t *buf;
+  void (*done)(struct i2c_job *job);
+  volatile uint8_t status;
+} i2c_job_t;
+
+typedef struct i2c_stats {
+  uint32_t transactions;
+  uint16_t nacks;
+  uint16_t bus_errors;
+  uint16_t timeouts;
+  uint16_t bus_clears;
+  uint16_t max_block_us;  // longest a blocking caller waited
+} i2c_stats_t;
+
+void i2c_init();
+void i2c_poll();
+bool i2c_submit(i2c_job_t *job);
+uint8_t i2c_wait(i2c_job_t *job);
+
+// Blocking helpers; return I2C_DONE on success
+uint8_t i2c_read(uint8_t addr, uint8_t reg, uint8_t *buf, uint8_t len);
+uint8_t i2c_write(uint8_t addr, uint8_t reg, const uint8_t *buf, uint8_t len);
+
+void i2c_get_stats(i2c_stats_t *out);
+void i2c_reset_stats();
+
+#endif
@@ -0,0 +1,224 @@
+#include "key_filter.h"
+
+#include <Arduino.h>
+#include "signal_capture.h"
+
+// AKS group (0 = none) is bits 2-3 of the QT2120 key control register
+#define AKS_GROUP(ctrl)   (((ctrl) >> 2) & 0x03)
+
+#define COUNT_BITS        3
+
+static key_filter_config_t config = {
+  KEY_FILTER_DEFAULT_ENABLED,
+  KEY_FILTER_DEFAULT_ON_COUNT,
+  KEY_FILTER_DEFAULT_OFF_COUNT,
+  KEY_FILTER_GROUPS_NONE
+};
+
+static key_filter_stats_t stats;
+static unsigned long last_step_at;
+static unsigned long groups_at;
+static bool groups_valid;
+
+// Vertical counters: bit b of every pad's count lives in count[b]. A pad
+// counts up while its raw state differs from its filtered one.
+static cap_touch_buttons_t count[COUNT_BITS];
+
+// The on/off counts as bit planes: all ones where that bit of the count is set
+static cap_touch_buttons_t on_plane[COUNT_BITS];
+static cap_touch_buttons_t off_plane[COUNT_BITS];
+
+static cap_touch_buttons_t debounced;
+static cap_touch_buttons_t reported;
+static cap_touch_buttons_t suppressed;
+
+static cap_touch_buttons_t group_mask[KEY_FILTER_GROUP_COUNT];
+
+static void set_planes(cap_touch_buttons_t *planes, uint8_t n) {
+  for (uint8_t b = 0; b < COUNT_BITS; ++b) {
+    planes[b] = (n & (1 << b)) ? ~(cap_touch_buttons_t)0 : 0;
+  }
+}
+
+static void set_groups(const uint8_t *group) {
+  memset(group_mask, 0, sizeof(group_mask));
+  for (int i = 0; i < CAP_TOUCH_PAD_COUNT; ++i) {
+    if (group[i]) {
+      group_mask[group[i] - 1] |= CAP_TOUCH_PAD_BIT(i);
+    }
+  }
+}
+
+// Group membership from the AKS bits; re-read now and then as key control
+// can be changed behind our back
+static void refresh_aks_groups() {
+  unsigned long now = millis();
+  if (groups_valid && (now - groups_at) < KEY_FILTER_AKS_REFRESH_MS) {
+    return;
+  }
+  if (cap_touch_reset_state() != CAP_TOUCH_RESET_READY) {
+    return;
+  }
+
+  cap_touch_config_t ct;
+  cap_touch_read_config(&ct);
+  uint8_t group[CAP_TOUCH_PAD_COUNT];
+  for (int i = 0; i < CAP_TOUCH_PAD_COUNT; ++i) {
+    group[i] = AKS_GROUP(ct.key_control[i]);
+  }
+  set_groups(group);
+  groups_at = now;
+  groups_valid = true;
+}
+
+void key_filter_init() {
+  memset(count, 0, sizeof(count));
+  debounced = 0;
+  reported = 0;
+  suppressed = 0;
+  set_planes(on_plane, config.on_count);
+  set_planes(off_plane, config.off_count);
+  if (config.groups == KEY_FILTER_GROUPS_FIRMWARE) {
+    set_groups(config.group);
+  } else {
+    memset(group_mask, 0, sizeof(group_mask));
+  }
+  groups_valid = false;
+}
+
+void key_filter_get_config(key_filter_config_t *out) {
+  *out = config;
+}
+
+void key_filter_set_config(const key_filter_config_t *in) {
+  config = *in;
+  config.on_count = constrain(config.on_count, 1, KEY_FILTER_MAX_COUNT);
+  config.off_count = constrain(config.off_count, 1, KEY_FILTER_MAX_COUNT);
+  if (config.groups > KEY_FILTER_GROUPS_FIRMWARE) {
+    config.groups = KEY_FILTER_GROUPS_NONE;
+  }
+  for (int i = 0; i < CAP_TOUCH_PAD_COUNT; ++i) {
+    if (config.group[i] > KEY_FILTER_GROUP_COUNT) {
+      config.group[i] = 0;
+    }
+  }
+  key_filter_init();
+
+  // Arbitration compares deltas, which are only as fresh as the capture
+  bool arbitrating = config.enabled && config.groups != KEY_FILTER_GROUPS_NONE;
+  signal_capture_request(SIGNAL_CAPTURE_KEY_FILTER, arbitrating ? KEY_FILTER_CAPTURE_MS : 0, false);
+}
+
+static void debounce_step(cap_touch_buttons_t raw) {
+  cap_touch_buttons_t changed = raw ^ debounced;
+
+  // A count that's running but no longer wanted was a bounce
+  cap_touch_buttons_t counting = 0;
+  for (uint8_t b = 0; b < COUNT_BITS; ++b) {
+    counting |= count[b];
+  }
+  if (counting & ~changed) {
+    stats.bounces++;
+  }
+
+  // Ripple-carry increment where changed, clear everywhere else
+  cap_touch_buttons_t carry = changed;
+  for (uint8_t b = 0; b < COUNT_BITS; ++b) {
+    cap_touch_buttons_t bit = count[b];
+    count[b] = (bit ^ carry) & changed;
+    carry &= bit;
+  }
+
+  // Pads whose count has reached the limit for their current state
+  cap_touch_buttons_t at_on = ~(cap_touch_buttons_t)0;
+  cap_touch_buttons_t at_off = ~(cap_touch_buttons_t)0;
+  for (uint8_t b = 0; b < COUNT_BITS; ++b) {
+    at_on &= ~(count[b] ^ on_plane[b]);
+    at_off &= ~(count[b] ^ off_plane[b]);
+  }
+  cap_touch_buttons_t flip = changed & ((~debounced & at_on) | (debounced & at_off));
+
+  debounced ^= flip;
+  for (uint8_t b = 0; b < COUNT_BITS; ++b) {
+    count[b] &= ~flip;
+  }
+}
+
+// Strongest delta among the touched pads of a group. The pad already
+// reported keeps the touch unless it's beaten by the switch margin.
+static uint8_t strongest(cap_touch_buttons_t active) {
+  int8_t holder = -1;
+  int16_t holder_delta = 0;
+  int8_t best = -1;
+  int16_t best_delta = INT16_MIN;
+
+  for (int i = 0; i < CAP_TOUCH_PAD_COUNT; ++i) {
+    if (!(active & CAP_TOUCH_PAD_BIT(i))) {
+      continue;
+    }
+    int16_t d = signal_capture_delta(i);
+    if (holder < 0 && (reported & CAP_TOUCH_PAD_BIT(i))) {
+      holder = i;
+      holder_delta = d;
+    }
+    if (best < 0 || d > best_delta) {
+      best = i;
+      best_delta = d;
+    }
+  }
+
+  if (holder >= 0 && (long)best_delta * 100 <= (long)holder_delta * (100 + KEY_FILTER_SWITCH_MARGIN)) {
+    return holder;
+  }
+  return best;
+}
+
+static cap_touch_buttons_t arbitrate(cap_touch_buttons_t touched) {
+  cap_touch_buttons_t out = touched;
+  for (uint8_t g = 0; g < KEY_FILTER_GROUP_COUNT; ++g) {
+    cap_touch_buttons_t active = touched & group_mask[g];
+    // Nothing to do unless at least two bits are set
+    if (!(active & (active - 1))) {
+      continue;
+    }
+    out &= ~active | CAP_TOUCH_PAD_BIT(strongest(active));
+  }
+
+  cap_touch_buttons_t hidden = touched & ~out;
+  for (cap_touch_buttons_t fresh = hidden & ~suppressed; fresh; fresh &= fresh - 1) {
+    stats.suppressed++;
+  }
+  suppressed = hidden;
+  return out;
+}
+
+cap_touch_buttons_t key_filter_apply(cap_touch_buttons_t buttons) {
+  if (!config.enabled) {
+    return buttons;
+  }
+
+  unsigned long now = millis();
+  if ((now - last_step_at) >= KEY_FILTER_STEP_MS) {
+    last_step_at = now;
+    debounce_step(buttons);
+  }
+
+  if (config.groups == KEY_FILTER_GROUPS_NONE) {
+    reported = debounced;
+    return reported;
+  }
+
+  if (config.groups == KEY_FILTER_GROUPS_AKS) {
+    refresh_aks_groups();
+  }
+  reported = arbitrate(debounced);
+  return reported;
+}
+
+void key_filter_get_stats(key_filter_stats_t *out) {
+  *out = stats;
+}
+
+void key_filter_reset_stats() {
+  memset(&stats, 0, sizeof(stats));
+}
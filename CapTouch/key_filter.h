@@ -0,0 +1,65 @@
+#ifndef KEY_FILTER_H
+#define KEY_FILTER_H
+
+#include <stdint.h>
+#include "cap_touch.h"
+
+// Key filter
+// ----------
+// Sits between acquisition and the modes so ghost touches on neighbouring
+// pads (long traces coupling into each other) don't reach the host as
+// note-on/off pairs.
+//
+// debounce : every KEY_FILTER_STEP_MS, a pad has to read differently from
+//            its filtered state on_count (touch) or off_count (release)
+//            steps in a row before the filtered state follows
+// groups   : pads in the same group suppress each other; while more than
+//            one is touched only the one with the strongest delta is
+//            reported. It keeps the touch until another pad's delta beats
+//            it by KEY_FILTER_SWITCH_MARGIN percent. Groups come from the
+//            AKS bits of the pads' key control (the chip applies its own AKS
+//            to these as well), or from the firmware group table.
+//
+// Debounce runs on all pads at once as vertical counters (one bit plane per
+// counter bit), so its cost doesn't depend on the number of pads or how
+// many are touched. Group arbitration only looks at individual pads when a
+// group actually has more than one touched. Deltas come from signal
+// capture, which runs at KEY_FILTER_CAPTURE_MS or faster while groups are
+// in use.
+
+#define KEY_FILTER_STEP_MS          10
+#define KEY_FILTER_MAX_COUNT        7
+#define KEY_FILTER_GROUP_COUNT      4
+#define KEY_FILTER_SWITCH_MARGIN    25
+#define KEY_FILTER_CAPTURE_MS       20
+#define KEY_FILTER_AKS_REFRESH_MS   1000
+
+#define KEY_FILTER_GROUPS_NONE      0
+#define KEY_FILTER_GROUPS_AKS       1
+#define KEY_FILTER_GROUPS_FIRMWARE  2
+
+#define KEY_FILTER_DEFAULT_ENABLED    0
+#define KEY_FILTER_DEFAULT_ON_COUNT   2
+#define KEY_FILTER_DEFAULT_OFF_COUNT  2
+
+typedef struct __attribute__ ((packed)) key_filter_config {
+  uint8_t enabled;
+  uint8_t on_count;       // 1-KEY_FILTER_MAX_COUNT steps
+  uint8_t off_count;
+  uint8_t groups;
+  uint8_t group[CAP_TOUCH_PAD_COUNT];   // firmware groups; 0 = none
+} key_filter_config_t;
+
+typedef struct key_filter_stats {
+  uint32_t bounces;       // steps on which a pad changed back before its count
+  uint32_t suppressed;    // pad touches hidden by a stronger one in its group
+} key_filter_stats_t;
+
+void key_filter_init();
+void key_filter_get_config(key_filter_config_t *out);
+void key_filter_set_config(const key_filter_config_t *in);
+cap_touch_buttons_t key_filter_apply(cap_touch_buttons_t buttons);
+void key_filter_get_stats(key_filter_stats_t *out);
+void key_filter_reset_stats();
+
+#endif
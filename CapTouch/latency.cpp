@@ -0,0 +1,71 @@
+#include "latency.h"
+
+#include <Arduino.h>
+#include "modes.h"
+#include "mode_selection.h"
+
+static latency_stats_t stats[MODE_COUNT];
+static uint16_t dropped;
+
+static cap_touch_buttons_t last_buttons;
+static bool last_touched;
+static bool pending;
+static unsigned long pending_at;
+
+void latency_acquired(const cap_touch_state_t *state) {
+  bool touched = state->slider >= 0;
+  bool edge = (state->buttons != last_buttons) || (touched != last_touched);
+  last_buttons = state->buttons;
+  last_touched = touched;
+
+  if (pending && (micros() - pending_at) >= LATENCY_TIMEOUT_US) {
+    pending = false;
+    dropped++;
+  }
+  if (edge && !pending) {
+    pending = true;
+    pending_at = state->edge_us;
+  }
+}
+
+static uint8_t bucket_of(uint32_t us) {
+  uint8_t b = 0;
+  for (us >>= LATENCY_BUCKET_SHIFT; us && b < LATENCY_BUCKETS - 1; us >>= 1) {
+    b++;
+  }
+  return b;
+}
+
+void latency_sent() {
+  int mode = mode_selection_get();
+  if (!pending || mode < 0) {
+    return;
+  }
+  pending = false;
+
+  uint32_t us = micros() - pending_at;
+  latency_stats_t *s = &stats[mode];
+  if (s->count == 0xFFFF) {
+    return;
+  }
+  s->buckets[bucket_of(us)]++;
+  s->count++;
+  s->total_us += us;
+  if (us > s->max_us) {
+    s->max_us = us;
+  }
+}
+
+void latency_get_stats(uint8_t mode, latency_stats_t *out) {
+  *out = stats[mode];
+}
+
+uint16_t latency_dropped() {
+  return dropped;
+}
+
+void latency_reset() {
+  memset(stats, 0, sizeof(stats));
+  dropped = 0;
+  pending = false;
+}
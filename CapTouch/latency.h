@@ -0,0 +1,43 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdint.h>
+#include "cap_touch.h"
+
+// Touch latency
+// -------------
+// Time from a touch or release reaching the firmware (the CHANGE interrupt
+// that asked for the status read that saw it) to the current mode handing
+// its report to USB, kept as a histogram per mode.
+//
+// The first edge not yet reported is the one that's timed; edges that come
+// before the report goes out are covered by it. An edge that produces no
+// report within LATENCY_TIMEOUT_US (filtered out, or a mode that doesn't
+// map the pad) is dropped and counted as such.
+//
+// Bucket 0 is everything under 2^LATENCY_BUCKET_SHIFT us, and each bucket
+// after it covers twice the time of the one before; the last one is
+// open-ended.
+
+#define LATENCY_BUCKETS         12
+#define LATENCY_BUCKET_SHIFT    9
+#define LATENCY_TIMEOUT_US      1000000UL
+
+typedef struct latency_stats {
+  uint16_t buckets[LATENCY_BUCKETS];
+  uint16_t count;
+  uint32_t total_us;
+  uint32_t max_us;
+} latency_stats_t;
+
+// With every acquired state, before any filtering
+void latency_acquired(const cap_touch_state_t *state);
+
+// From a mode, as soon as it has handed a report to USB
+void latency_sent();
+
+void latency_get_stats(uint8_t mode, latency_stats_t *out);
+uint16_t latency_dropped();
+void latency_reset();
+
+#endif
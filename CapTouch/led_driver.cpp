@@ -1,6 +1,7 @@
 #include "led_driver.h"
 #include <Arduino.h>
 #include <avr/interrupt.h>
+#include "profiler.h"
 
 #define TX_BUFFER_SIZE  (4 + (LED_COUNT * 4) + 4)
 
@@ -94,6 +95,7 @@ void leds_flush() {
 }
 
 ISR(SPI_STC_vect) {
+  PROFILE_BEGIN(PROFILE_SPI_ISR);
   if (tx_pos == TX_BUFFER_SIZE) {
     if (tx_state == TX_BUSY_DIRTY) {
       transmit();
@@ -103,4 +105,5 @@ ISR(SPI_STC_vect) {
   } else {
     SPDR = transmit_buffer[tx_pos++];
   }
+  PROFILE_END(PROFILE_SPI_ISR);
 }
@@ -0,0 +1,109 @@
+#include "lp_governor.h"
+
+#include <Arduino.h>
+
+static lp_governor_config_t config = {
+  LP_GOVERNOR_DEFAULT_ENABLED,
+  LP_GOVERNOR_DEFAULT_FAST_LP,
+  LP_GOVERNOR_DEFAULT_SLOW_LP,
+  LP_GOVERNOR_DEFAULT_FAST_DWELL,
+  LP_GOVERNOR_DEFAULT_IDLE_DWELL
+};
+
+static lp_governor_stats_t stats;
+static uint8_t state = LP_GOVERNOR_FAST;
+static unsigned long entered_at;
+static unsigned long active_at;
+static unsigned long accounted_at;
+
+static void account(unsigned long now) {
+  uint32_t elapsed = now - accounted_at;
+  if (state == LP_GOVERNOR_FAST) {
+    stats.fast_ms += elapsed;
+  } else {
+    stats.slow_ms += elapsed;
+  }
+  accounted_at = now;
+}
+
+static void enter(uint8_t new_state, unsigned long now) {
+  if (new_state == state) {
+    return;
+  }
+  account(now);
+  state = new_state;
+  entered_at = now;
+  stats.transitions++;
+  cap_touch_set_poll_interval((state == LP_GOVERNOR_FAST) ? CAP_TOUCH_POLL_INTERVAL_MS : LP_GOVERNOR_SLOW_POLL_MS);
+}
+
+void lp_governor_init() {
+  unsigned long now = millis();
+  state = LP_GOVERNOR_FAST;
+  entered_at = now;
+  active_at = now;
+  accounted_at = now;
+}
+
+void lp_governor_get_config(lp_governor_config_t *out) {
+  *out = config;
+}
+
+void lp_governor_set_config(const lp_governor_config_t *in) {
+  config = *in;
+  // LP_MODE 0 stops the chip measuring altogether
+  if (config.fast_lp == 0) {
+    config.fast_lp = 1;
+  }
+  if (config.slow_lp == 0) {
+    config.slow_lp = 1;
+  }
+  if (!config.enabled) {
+    // update() stops writing LP_MODE now, so don't leave the chips at
+    // slow_lp; in fast they're already at fast_lp
+    if (state == LP_GOVERNOR_SLOW) {
+      cap_touch_set_lp_mode(config.fast_lp);
+    }
+    enter(LP_GOVERNOR_FAST, millis());
+  }
+}
+
+void lp_governor_wake() {
+  unsigned long now = millis();
+  active_at = now;
+  enter(LP_GOVERNOR_FAST, now);
+}
+
+void lp_governor_update(const cap_touch_state_t *state_in) {
+  if (!config.enabled) {
+    return;
+  }
+
+  unsigned long now = millis();
+  if (state_in->buttons || state_in->slider >= 0) {
+    active_at = now;
+    enter(LP_GOVERNOR_FAST, now);
+  } else if (state == LP_GOVERNOR_FAST &&
+             (now - active_at) >= config.idle_dwell * 1000UL &&
+             (now - entered_at) >= config.fast_dwell) {
+    enter(LP_GOVERNOR_SLOW, now);
+  }
+
+  // Reapplied every time so the value survives a controller reset; only an
+  // actual change reaches the bus
+  cap_touch_set_lp_mode((state == LP_GOVERNOR_FAST) ? config.fast_lp : config.slow_lp);
+}
+
+uint8_t lp_governor_state() {
+  return state;
+}
+
+void lp_governor_get_stats(lp_governor_stats_t *out) {
+  account(millis());
+  *out = stats;
+}
+
+void lp_governor_reset_stats() {
+  memset(&stats, 0, sizeof(stats));
+  accounted_at = millis();
+}
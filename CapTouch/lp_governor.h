@@ -0,0 +1,65 @@
+#ifndef LP_GOVERNOR_H
+#define LP_GOVERNOR_H
+
+#include <stdint.h>
+#include "cap_touch.h"
+
+// LP_MODE governor
+// ----------------
+// Runs the touch controllers at fast_lp while they're in use and drops to
+// slow_lp (and a longer fallback poll) once nothing has been touched for
+// idle_dwell seconds. Any touch switches straight back to fast; the chip
+// still detects the first touch in slow mode, just up to one slow interval
+// later.
+// Having switched to fast, the governor stays there for at least
+// fast_dwell ms so a brief touch doesn't bounce it straight back.
+//
+// LP_MODE is the chip's sleep between measurements in 16ms units (0 stops
+// measuring, so the governor never writes it). While enabled the governor
+// owns LP_MODE and overrides the value in cap_touch_config_t; saved
+// defaults then carry fast_lp there rather than whichever value the chips
+// happen to be at.
+//
+// Off by default (ct_lp on): the slow poll stretches touch latency when
+// the CHANGE interrupt isn't wired.
+
+#define LP_GOVERNOR_FAST          0
+#define LP_GOVERNOR_SLOW          1
+
+#define LP_GOVERNOR_SLOW_POLL_MS  (CAP_TOUCH_POLL_INTERVAL_MS * 5)
+
+#define LP_GOVERNOR_DEFAULT_ENABLED     0
+#define LP_GOVERNOR_DEFAULT_FAST_LP     1
+#define LP_GOVERNOR_DEFAULT_SLOW_LP     8
+#define LP_GOVERNOR_DEFAULT_FAST_DWELL  2000
+#define LP_GOVERNOR_DEFAULT_IDLE_DWELL  10
+
+typedef struct __attribute__ ((packed)) lp_governor_config {
+  uint8_t enabled;
+  uint8_t fast_lp;
+  uint8_t slow_lp;
+  uint16_t fast_dwell;    // ms
+  uint16_t idle_dwell;    // s
+} lp_governor_config_t;
+
+typedef struct lp_governor_stats {
+  uint32_t fast_ms;
+  uint32_t slow_ms;
+  uint16_t transitions;
+} lp_governor_stats_t;
+
+void lp_governor_init();
+void lp_governor_get_config(lp_governor_config_t *out);
+void lp_governor_set_config(const lp_governor_config_t *in);
+
+// Call with every touch state; cheap when nothing changes
+void lp_governor_update(const cap_touch_state_t *state);
+
+// Treat as activity without a touch (e.g. proximity)
+void lp_governor_wake();
+
+uint8_t lp_governor_state();
+void lp_governor_get_stats(lp_governor_stats_t *out);
+void lp_governor_reset_stats();
+
+#endif
@@ -53,8 +53,14 @@ bool mode_selection_set(int new_mode) {
 	return true;
 }
 
-void mode_selection_emit(uint8_t buttons, int slider) {
+void mode_selection_emit(cap_touch_buttons_t buttons, int slider) {
 	if (current_mode >= 0) {
 		Modes[current_mode]->update(buttons, slider);	
 	}
 }
+
+void mode_selection_gesture(uint8_t gesture) {
+	if (current_mode >= 0 && gesture != SLIDER_GESTURE_NONE) {
+		Modes[current_mode]->gesture(gesture);
+	}
+}
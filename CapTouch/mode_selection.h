@@ -2,11 +2,13 @@
 #define MODE_SELECTION_H
 
 #include <stdint.h>
+#include "cap_touch.h"
 
 void mode_selection_init(int initial_mode);
 void mode_selection_next();
 int mode_selection_get();
 bool mode_selection_set(int mode);
-void mode_selection_emit(uint8_t buttons, int slider);
+void mode_selection_emit(cap_touch_buttons_t buttons, int slider);
+void mode_selection_gesture(uint8_t gesture);
 
 #endif
\ No newline at end of file
@@ -8,12 +8,17 @@
 #include <stdint.h>
 #include "console.h"
 #include "settings.h"
+#include "cap_touch.h"
+#include "slider_gesture.h"
+#include "latency.h"
 
 class Mode {
 public:
   void activate() {
     buttonsPrev = 0;
     sliderPrev = -1;
+    // A swipe started in the last mode isn't one for this one
+    slider_gesture_reset();
     activateHardware();
   }
 
@@ -21,7 +26,7 @@ public:
     deactivateHardware();
   }
 
-  void update(uint8_t buttons, int slider) {
+  void update(cap_touch_buttons_t buttons, int slider) {
     buttonsCurr = buttons;
     sliderCurr = slider;
     process();
@@ -29,16 +34,28 @@ public:
     sliderPrev = sliderCurr;
   }
 
+  void gesture(uint8_t g) {
+    processGesture(g);
+  }
+
 protected:
   virtual void activateHardware() = 0;
   virtual void deactivateHardware() = 0;
   virtual void process() = 0;
 
+  // Slider gestures are ignored unless a mode binds them
+  virtual void processGesture(uint8_t g) {}
+
   bool changed() {
     return (buttonsPrev != buttonsCurr) || (sliderPrev != sliderCurr);
   }
 
-  byte buttonsPrev, buttonsCurr;
+  // Call once a report has been handed to USB, for the latency histogram
+  void sent() {
+    latency_sent();
+  }
+
+  cap_touch_buttons_t buttonsPrev, buttonsCurr;
   int sliderPrev, sliderCurr;
 };
 
@@ -52,9 +69,9 @@ protected:
       return;
     }
     
-    uint8_t b = buttonsCurr;
+    cap_touch_buttons_t b = buttonsCurr;
     CONSOLE_PORT.print("> ");
-    for (int i = 0; i < 8; ++i) {
+    for (int i = 0; i < CAP_TOUCH_PAD_COUNT; ++i) {
       CONSOLE_PORT.print((b & 0x01) ? 'X' : '_');
       b >>= 1;  
     }
@@ -62,12 +79,19 @@ protected:
     CONSOLE_PORT.print(" ");
     CONSOLE_PORT.print(sliderCurr);
     CONSOLE_PORT.println();
+    sent();
+  }
+
+  void processGesture(uint8_t g) {
+    static const char *const names[] = { "", "tap", "hold", "swipe up", "swipe down", "flick up", "flick down" };
+    CONSOLE_PORT.print("> ");
+    CONSOLE_PORT.println(names[g]);
   }
 };
 
 class KeyboardMode : public Mode {
 protected:
-  KeyboardMode(char *keys) : keyMap(keys) {}
+  KeyboardMode(char *keys, uint8_t count) : keyMap(keys), keyCount(count) {}
 
   void activateHardware() {
     Keyboard.begin();
@@ -79,19 +103,23 @@ protected:
   }
   
   void process() {
-    for (int i = 0; i < 8; ++i) {
-      bool wasPressed = buttonsPrev & (1 << i);
-      bool isPressed = buttonsCurr & (1 << i);
+    // Pads beyond the end of the key map do nothing
+    for (int i = 0; i < keyCount && i < CAP_TOUCH_PAD_COUNT; ++i) {
+      bool wasPressed = buttonsPrev & CAP_TOUCH_PAD_BIT(i);
+      bool isPressed = buttonsCurr & CAP_TOUCH_PAD_BIT(i);
       if (!wasPressed && isPressed) {
         Keyboard.press(keyMap[i]);
+        sent();
       } else if (wasPressed && !isPressed) {
         Keyboard.release(keyMap[i]);
+        sent();
       }
     }
   }
 
 private:
   char *keyMap;
+  uint8_t keyCount;
 };
 
 static char numericKeyMap[] = {
@@ -107,7 +135,7 @@ static char numericKeyMap[] = {
 
 class NumericKeyboardMode : public KeyboardMode {
 public:
-  NumericKeyboardMode() : KeyboardMode(numericKeyMap) {}
+  NumericKeyboardMode() : KeyboardMode(numericKeyMap, sizeof(numericKeyMap)) {}
 };
 
 static char cursorKeyMap[] = {
@@ -123,7 +151,17 @@ static char cursorKeyMap[] = {
 
 class CursorKeyboardMode : public KeyboardMode {
 public:
-  CursorKeyboardMode() : KeyboardMode(cursorKeyMap) {}  
+  CursorKeyboardMode() : KeyboardMode(cursorKeyMap, sizeof(cursorKeyMap)) {}  
+
+protected:
+  void processGesture(uint8_t g) {
+    switch (g) {
+      case SLIDER_GESTURE_SWIPE_UP:   Keyboard.write(KEY_PAGE_UP); break;
+      case SLIDER_GESTURE_SWIPE_DOWN: Keyboard.write(KEY_PAGE_DOWN); break;
+      case SLIDER_GESTURE_FLICK_UP:   Keyboard.write(KEY_HOME); break;
+      case SLIDER_GESTURE_FLICK_DOWN: Keyboard.write(KEY_END); break;
+    }
+  }
 };
 
 static char midiNoteMap[] = {
@@ -138,44 +176,82 @@ static char midiNoteMap[] = {
 };
 
 class MIDIMode : public Mode {
+public:
+  MIDIMode() : program(0) {}
+
 protected:
   void activateHardware() {}
   void deactivateHardware() {}
 
+  // With gestures on, swipes step through programs and flicks jump a bank
+  // of eight. The slider then sends nothing else, or every program change
+  // would bend the note that's playing.
+  void processGesture(uint8_t g) {
+    if (!settings_are_midi_gestures_enabled()) {
+      return;
+    }
+    int next = program;
+    switch (g) {
+      case SLIDER_GESTURE_SWIPE_UP:   next += 1; break;
+      case SLIDER_GESTURE_SWIPE_DOWN: next -= 1; break;
+      case SLIDER_GESTURE_FLICK_UP:   next += 8; break;
+      case SLIDER_GESTURE_FLICK_DOWN: next -= 8; break;
+      default: return;
+    }
+    program = constrain(next, 0, 127);
+    midiEventPacket_t evt = { 0x0C, 0xC0 | settings_get_midi_channel(), program, 0 };
+    MIDI.sendMIDI(evt);
+    MIDI.flush();
+  }
+
   void process() {
-    for (int i = 0; i < 8; ++i) {
-      bool wasPressed = buttonsPrev & (1 << i);
-      bool isPressed = buttonsCurr & (1 << i);
+    bool any = false;
+    for (int i = 0; i < CAP_TOUCH_PAD_COUNT; ++i) {
+      bool wasPressed = buttonsPrev & CAP_TOUCH_PAD_BIT(i);
+      bool isPressed = buttonsCurr & CAP_TOUCH_PAD_BIT(i);
       if (!wasPressed && isPressed) {
-        midiEventPacket_t evt = { 0x09, 0x90 | settings_get_midi_channel(), midiNoteMap[i], 127 };
+        midiEventPacket_t evt = { 0x09, 0x90 | settings_get_midi_channel(), note(i), 127 };
         MIDI.sendMIDI(evt);
+        any = true;
       } else if (wasPressed && !isPressed) {
-        midiEventPacket_t evt = { 0x08, 0x80 | settings_get_midi_channel(), midiNoteMap[i], 0 };
+        midiEventPacket_t evt = { 0x08, 0x80 | settings_get_midi_channel(), note(i), 0 };
         MIDI.sendMIDI(evt);
+        any = true;
       }
     }
-    if (sliderCurr != sliderPrev) {
+    if (sliderCurr != sliderPrev && !settings_are_midi_gestures_enabled()) {
+      any = true;
       uint8_t controller = settings_get_midi_controller();
       if (controller == 0) {
         uint16_t pitch = 0x2000;
         if (sliderCurr >= 0) {
-          pitch = mapRange(0, 255, 0, 0x3FFF, sliderCurr);
+          pitch = mapRange(0, CAP_TOUCH_SLIDER_MAX, 0, 0x3FFF, sliderCurr);
         }
         midiEventPacket_t evt = { 0x0E, 0xE0 | settings_get_midi_channel(), pitch & 0x7F, (pitch >> 7) & 0x7F };
         MIDI.sendMIDI(evt);
       } else {
         uint16_t val = 0;
         if (sliderCurr >= 0) {
-          val = mapRange(0, 255, 0, 127, sliderCurr);
+          val = mapRange(0, CAP_TOUCH_SLIDER_MAX, 0, 127, sliderCurr);
         }
         midiEventPacket_t evt = { 0x0B, 0xB0 | settings_get_midi_channel(), controller, val };
         MIDI.sendMIDI(evt);
       }
     }
     MIDI.flush();
+    if (any) {
+      sent();
+    }
   }
 
 private:
+  uint8_t program;
+
+  // Each further row of eight pads plays an octave higher
+  uint8_t note(int pad) {
+    return midiNoteMap[pad % 8] + 12 * (pad / 8);
+  }
+
   long mapRange(long in1, long in2, long out1, long out2, long v) {
     long a = v - in1;
     long b = out2 - out1;
@@ -215,6 +291,7 @@ protected:
   void deactivateHardware() {}
 
   void process() {
+    // Only the first eight pads are mapped
     uint8_t b = buttonsCurr;
     
     bool up = b & 0x01;
@@ -243,13 +320,16 @@ protected:
       b >>= 1;
     }
 
-    int16_t slider = sliderCurr;
-    if (slider < 0) {
+    int16_t slider = sliderCurr >> (CAP_TOUCH_SLIDER_BITS - 8);
+    if (sliderCurr < 0) {
       slider = 128;
     }
     stick.setZAxis(slider - 128);
 
     stick.sendState();
+    if (changed()) {
+      sent();
+    }
   }
 
 private:
@@ -0,0 +1,54 @@
+#include "profiler.h"
+
+#if PT_PROFILING
+
+#include <Arduino.h>
+#include <util/atomic.h>
+
+static const char* const names[PROFILE_COUNT] = {
+  "buttons",
+  "console",
+  "cap_touch",
+  "emit",
+  "leds",
+  "spi_isr",
+  "timer3_isr"
+};
+
+static profile_stats_t stats[PROFILE_COUNT];
+
+// Called from interrupt handlers too; each ID only ever comes from one
+// context, so the update itself needs no locking
+void profiler_record(uint8_t id, uint32_t started_at) {
+  uint32_t now = scheduler_timer_now();
+  uint32_t counts = (now >= started_at) ? (now - started_at) : (now + SCHEDULER_TIMER_WRAP - started_at);
+  uint32_t cycles = counts * SCHEDULER_PRESCALE;
+
+  profile_stats_t *s = &stats[id];
+  if (s->calls == 0 || cycles < s->min) {
+    s->min = cycles;
+  }
+  if (cycles > s->max) {
+    s->max = cycles;
+  }
+  s->total += counts;
+  s->calls++;
+}
+
+const char* profiler_name(uint8_t id) {
+  return names[id];
+}
+
+void profiler_get_stats(uint8_t id, profile_stats_t *out) {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    *out = stats[id];
+  }
+}
+
+void profiler_reset() {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    memset(stats, 0, sizeof(stats));
+  }
+}
+
+#endif
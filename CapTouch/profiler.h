@@ -0,0 +1,54 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdint.h>
+
+// Profiler
+// --------
+// Min/avg/max CPU cycles and call counts for the main stages and the busy
+// interrupt handlers, timed with the scheduler's Timer1 (SCHEDULER_PRESCALE
+// cycles per count). Stage times include any interrupts taken meanwhile.
+//
+// Only built with PT_PROFILING set to 1; otherwise the PROFILE_ macros are
+// empty and nothing is compiled in.
+
+#ifndef PT_PROFILING
+#define PT_PROFILING      0
+#endif
+
+#define PROFILE_BUTTONS       0
+#define PROFILE_CONSOLE       1
+#define PROFILE_CAP_TOUCH     2
+#define PROFILE_EMIT          3
+#define PROFILE_LEDS          4
+#define PROFILE_SPI_ISR       5
+#define PROFILE_TIMER3_ISR    6
+#define PROFILE_COUNT         7
+
+#if PT_PROFILING
+
+typedef struct profile_stats {
+  uint32_t calls;
+  uint32_t total;         // Timer1 counts, so it lasts ~35 minutes flat out
+  uint32_t min;           // cycles
+  uint32_t max;
+} profile_stats_t;
+
+void profiler_record(uint8_t id, uint32_t started_at);
+const char* profiler_name(uint8_t id);
+void profiler_get_stats(uint8_t id, profile_stats_t *out);
+void profiler_reset();
+
+#include "scheduler.h"
+
+#define PROFILE_BEGIN(id)   uint32_t profile_started_##id = scheduler_timer_now()
+#define PROFILE_END(id)     profiler_record(id, profile_started_##id)
+
+#else
+
+#define PROFILE_BEGIN(id)
+#define PROFILE_END(id)
+
+#endif
+
+#endif
@@ -0,0 +1,104 @@
+#include "proximity.h"
+
+#include <Arduino.h>
+#include "lp_governor.h"
+#include "signal_capture.h"
+
+static proximity_config_t config = {
+  PROXIMITY_DEFAULT_SOURCE,
+  PROXIMITY_DEFAULT_KEY_THRESHOLD,
+  PROXIMITY_DEFAULT_PULSE_SCALE,
+  PROXIMITY_DEFAULT_SUM_THRESHOLD
+};
+
+static proximity_stats_t stats;
+static bool near;
+static bool sum_near;
+static bool awaiting_touch;
+static unsigned long near_at;
+static unsigned long woke_at;
+static uint32_t last_frame;
+
+void proximity_get_config(proximity_config_t *out) {
+  *out = config;
+}
+
+void proximity_set_config(const proximity_config_t *in) {
+  config = *in;
+  if (config.source > PROXIMITY_SUM) {
+    config.source = PROXIMITY_OFF;
+  }
+  sum_near = false;
+  last_frame = signal_capture_frames();
+  signal_capture_request(SIGNAL_CAPTURE_PROXIMITY, (config.source == PROXIMITY_SUM) ? PROXIMITY_SUM_INTERVAL_MS : 0, false);
+}
+
+static void sum_frame() {
+  uint32_t frames = signal_capture_frames();
+  if (frames == last_frame) {
+    return;
+  }
+  last_frame = frames;
+
+  uint32_t sum = 0;
+  for (int i = 0; i < CAP_TOUCH_PAD_COUNT; ++i) {
+    int16_t d = signal_capture_delta(i);
+    if (d > 0 && cap_touch_pad_mapped(i)) {
+      sum += d;
+    }
+  }
+  sum_near = sum >= config.sum_threshold;
+}
+
+bool proximity_update(const cap_touch_state_t *state) {
+  // Reapplied every time so the values survive a controller reset or a
+  // topology change; only an actual change reaches the bus
+  cap_touch_set_proximity((config.source == PROXIMITY_KEY) ? config.key_threshold : 0, config.pulse_scale);
+
+  bool raw = false;
+  if (config.source == PROXIMITY_KEY) {
+    raw = state->proximity;
+  } else if (config.source == PROXIMITY_SUM) {
+    sum_frame();
+    raw = sum_near;
+  }
+
+  unsigned long now = millis();
+  bool touched = state->buttons || state->slider >= 0;
+
+  if (raw) {
+    if (!near && !touched) {
+      stats.wakes++;
+      woke_at = now;
+      awaiting_touch = true;
+    }
+    near = true;
+    near_at = now;
+  } else if (near && (now - near_at) >= PROXIMITY_HOLD_MS) {
+    near = false;
+  }
+
+  if (touched && awaiting_touch) {
+    stats.lead_ms = now - woke_at;
+    awaiting_touch = false;
+  } else if (!near) {
+    awaiting_touch = false;
+  }
+
+  if (near) {
+    lp_governor_wake();
+  }
+  return near;
+}
+
+bool proximity_is_near() {
+  return near;
+}
+
+void proximity_get_stats(proximity_stats_t *out) {
+  *out = stats;
+}
+
+void proximity_reset_stats() {
+  memset(&stats, 0, sizeof(stats));
+}
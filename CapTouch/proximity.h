@@ -0,0 +1,60 @@
+#ifndef PROXIMITY_H
+#define PROXIMITY_H
+
+#include <stdint.h>
+#include "cap_touch.h"
+
+// Proximity wake
+// --------------
+// Spots a hand on its way to the pads and wakes the scan rate governor (and
+// lights the LEDs) so the controllers are back at full speed before the
+// first touch lands. That hides the idle mode wake-up latency, which in
+// turn allows a much slower idle scan rate. Sources:
+//
+// key: keys given the proximity role in the topology (key 3 is spare on the
+//      standard board), run at high sensitivity: key_threshold is their
+//      detect threshold and pulse_scale their pulse/scale. The chip reports
+//      them like any other key, so this works at the idle scan rate.
+// sum: the sum of all positive pad deltas reaches sum_threshold. Needs no
+//      electrode, but only reacts as fast as signal capture, which runs at
+//      PROXIMITY_SUM_INTERVAL_MS or faster while this source is selected.
+//
+// Once near, the state is held for PROXIMITY_HOLD_MS so it doesn't flicker
+// at the edge of range. Keys with the proximity role are switched off
+// (threshold 0) unless the key source is selected.
+
+#define PROXIMITY_OFF     0
+#define PROXIMITY_KEY     1
+#define PROXIMITY_SUM     2
+
+#define PROXIMITY_SUM_INTERVAL_MS   50
+#define PROXIMITY_HOLD_MS           500
+
+#define PROXIMITY_DEFAULT_SOURCE        PROXIMITY_OFF
+#define PROXIMITY_DEFAULT_KEY_THRESHOLD 4
+#define PROXIMITY_DEFAULT_PULSE_SCALE   0x54
+#define PROXIMITY_DEFAULT_SUM_THRESHOLD 40
+
+typedef struct __attribute__ ((packed)) proximity_config {
+  uint8_t source;
+  uint8_t key_threshold;
+  uint8_t pulse_scale;
+  uint16_t sum_threshold;
+} proximity_config_t;
+
+typedef struct proximity_stats {
+  uint16_t wakes;
+  uint16_t lead_ms;       // from the last wake to the touch that followed it
+} proximity_stats_t;
+
+void proximity_get_config(proximity_config_t *out);
+void proximity_set_config(const proximity_config_t *in);
+
+// Call with every touch state, before the governor; true while near
+bool proximity_update(const cap_touch_state_t *state);
+
+bool proximity_is_near();
+void proximity_get_stats(proximity_stats_t *out);
+void proximity_reset_stats();
+
+#endif
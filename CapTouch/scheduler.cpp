@@ -0,0 +1,125 @@
+#include "scheduler.h"
+
+#include <Arduino.h>
+#include <util/atomic.h>
+#include "stall_monitor.h"
+
+typedef struct stage {
+  const char *name;
+  void (*run)();
+  uint16_t period;
+  uint16_t due;
+  scheduler_stats_t stats;
+} stage_t;
+
+static stage_t stages[SCHEDULER_STAGE_COUNT];
+static volatile uint16_t ticks;
+static void (*volatile tick_handler)();
+
+void scheduler_init() {
+  // CTC on OCR1A
+  TCCR1A = 0;
+  TCCR1B = (1 << WGM12) | (1 << CS11);   // /8
+  TCCR1C = 0;
+  TCNT1 = 0;
+  OCR1A = SCHEDULER_TIMER_TOP;
+  TIMSK1 = (1 << OCIE1A);
+}
+
+void scheduler_set_stage(uint8_t id, const char *name, void (*run)(), uint16_t period) {
+  if (id >= SCHEDULER_STAGE_COUNT) {
+    return;
+  }
+  stage_t *s = &stages[id];
+  s->name = name;
+  s->run = run;
+  s->period = period ? period : 1;
+  s->due = scheduler_ticks();
+}
+
+void scheduler_set_tick_handler(void (*tick)()) {
+  tick_handler = tick;
+}
+
+uint16_t scheduler_ticks() {
+  uint16_t t;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    t = ticks;
+  }
+  return t;
+}
+
+// Safe from interrupt handlers. A compare match that hasn't been serviced
+// yet (interrupts off) is counted, going by the counter having wrapped.
+uint32_t scheduler_timer_now() {
+  uint16_t count, t;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    count = TCNT1;
+    t = ticks;
+    if ((TIFR1 & (1 << OCF1A)) && count < (SCHEDULER_TIMER_TOP / 2)) {
+      t++;
+    }
+  }
+  return (uint32_t)t * (SCHEDULER_TIMER_TOP + 1) + count;
+}
+
+void scheduler_run() {
+  uint16_t now = scheduler_ticks();
+
+  for (uint8_t i = 0; i < SCHEDULER_STAGE_COUNT; ++i) {
+    stage_t *s = &stages[i];
+    if (!s->run || (int16_t)(now - s->due) < 0) {
+      continue;
+    }
+
+    uint16_t late = now - s->due;
+    if (late > s->stats.max_late) {
+      s->stats.max_late = late;
+    }
+    if (late >= s->period) {
+      s->stats.overruns++;
+      s->due = now + s->period;
+    } else {
+      s->due += s->period;
+    }
+
+    stall_monitor_enter(i);
+    unsigned long started_at = micros();
+    s->run();
+    unsigned long us = micros() - started_at;
+    stall_monitor_leave(us);
+    if (us > s->stats.max_us) {
+      s->stats.max_us = (us > 0xFFFF) ? 0xFFFF : us;
+    }
+    s->stats.runs++;
+
+    // Back to the top, in case something more important came due
+    return;
+  }
+}
+
+const char* scheduler_stage_name(uint8_t id) {
+  return stages[id].name;
+}
+
+uint16_t scheduler_stage_period(uint8_t id) {
+  return stages[id].period;
+}
+
+void scheduler_get_stats(uint8_t id, scheduler_stats_t *out) {
+  *out = stages[id].stats;
+}
+
+void scheduler_reset_stats() {
+  for (uint8_t i = 0; i < SCHEDULER_STAGE_COUNT; ++i) {
+    memset(&stages[i].stats, 0, sizeof(scheduler_stats_t));
+  }
+}
+
+ISR(TIMER1_COMPA_vect) {
+  ticks++;
+  void (*tick)() = tick_handler;
+  if (tick) {
+    tick();
+  }
+}
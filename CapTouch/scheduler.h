@@ -0,0 +1,53 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+
+// Scheduler
+// ---------
+// Cooperative, fixed-rate: Timer1 ticks at SCHEDULER_TICK_HZ and each stage
+// runs once every period ticks. Stage IDs are priorities (0 highest); every
+// call to scheduler_run() runs the highest priority stage that's due, so a
+// slow low priority stage delays the others by at most its own run time.
+//
+// Stages are due at fixed multiples of their period, so late runs don't
+// make them drift. A stage that's a whole period or more late has missed a
+// slot; that counts as an overrun and it starts again from now rather than
+// running back to back to catch up.
+
+#define SCHEDULER_TICK_HZ       1000
+#define SCHEDULER_PRESCALE      8
+#define SCHEDULER_TIMER_TOP     ((F_CPU / SCHEDULER_PRESCALE / SCHEDULER_TICK_HZ) - 1)
+
+// Timer1 counts, free running; wraps every SCHEDULER_TIMER_WRAP counts
+#define SCHEDULER_TIMER_WRAP    (65536UL * (SCHEDULER_TIMER_TOP + 1))
+
+#define SCHEDULER_STAGE_SCAN    0
+#define SCHEDULER_STAGE_BUTTONS 1
+#define SCHEDULER_STAGE_LEDS    2
+#define SCHEDULER_STAGE_CONSOLE 3
+#define SCHEDULER_STAGE_COUNT   4
+
+typedef struct scheduler_stats {
+  uint32_t runs;
+  uint16_t overruns;
+  uint16_t max_late;      // ticks
+  uint16_t max_us;        // longest run
+} scheduler_stats_t;
+
+void scheduler_init();
+void scheduler_set_stage(uint8_t id, const char *name, void (*run)(), uint16_t period);
+void scheduler_run();
+
+// Called from the timer interrupt on every tick, for work that has to keep
+// time whatever the stages are doing. Keep it short.
+void scheduler_set_tick_handler(void (*tick)());
+
+uint16_t scheduler_ticks();
+uint32_t scheduler_timer_now();
+const char* scheduler_stage_name(uint8_t id);
+uint16_t scheduler_stage_period(uint8_t id);
+void scheduler_get_stats(uint8_t id, scheduler_stats_t *out);
+void scheduler_reset_stats();
+
+#endif
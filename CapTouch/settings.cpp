@@ -2,28 +2,51 @@
 
 #include "Arduino.h"
 #include "modes.h"
+#include "mode_selection.h"
 
 static int mode;
 static bool tracking;
 static uint8_t midi_ch, midi_ctl;
+static bool midi_gestures;
 
-void settings_init(defaults_v1 *in) {
+void settings_init(defaults_t *in) {
   settings_set_startup_mode(in->startup_mode);
   settings_set_led_tracking_enabled(in->led_tracking_enabled > 0);
   settings_set_midi(in->midi_channel, in->midi_controller);
+  settings_set_midi_gestures_enabled(in->midi_gestures > 0);
 }
 
-void settings_export(defaults_v1 *out) {
+void settings_export(defaults_t *out) {
   out->startup_mode = mode;
   out->led_tracking_enabled = tracking;
   out->midi_channel = midi_ch;
   out->midi_controller = midi_ctl;  
+  out->midi_gestures = midi_gestures;
+}
+
+void settings_save_defaults() {
+  defaults_t to_save;
+  settings_export(&to_save);
+  cap_touch_read_config(&to_save.ct);
+  slider_filter_get_config(&to_save.slider_filter);
+  lp_governor_get_config(&to_save.lp_governor);
+  if (to_save.lp_governor.enabled) {
+    // Not the live LP_MODE, which is slow_lp whenever the chips are idle
+    to_save.ct.lp_mode = to_save.lp_governor.fast_lp;
+  }
+  cap_touch_get_topology(&to_save.topology);
+  proximity_get_config(&to_save.proximity);
+  key_filter_get_config(&to_save.key_filter);
+  drift_monitor_get_config(&to_save.drift_monitor);
+  to_save.startup_mode = mode_selection_get();
+  defaults_save(&to_save);
 }
 
 int settings_get_startup_mode() { return mode; }
 bool settings_is_led_tracking_enabled() { return tracking; }
 uint8_t settings_get_midi_channel() { return midi_ch; }
 uint8_t settings_get_midi_controller() { return midi_ctl; }
+bool settings_are_midi_gestures_enabled() { return midi_gestures; }
 
 void settings_set_startup_mode(int new_mode) {
   if (new_mode < 0) {
@@ -42,3 +65,7 @@ void settings_set_midi(uint8_t ch, uint8_t ctl) {
   midi_ch = ch & 0x0F;
   midi_ctl = ctl & 0x7F;
 }
+
+void settings_set_midi_gestures_enabled(bool enabled) {
+  midi_gestures = enabled;
+}
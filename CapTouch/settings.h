@@ -9,17 +9,25 @@
 // LED tracking enabled : bool
 // MIDI channel         : uint8_t, range: 0..15
 // MIDI controller      : uint8_t, range: 0..127
+// MIDI gestures        : bool; slider gestures change program instead of
+//                        the slider sending pitch bend/CC
 
-void settings_init(defaults_v1 *in);
-void settings_export(defaults_v1 *out);
+void settings_init(defaults_t *in);
+void settings_export(defaults_t *out);
+
+// Saves the active settings, mode and cap touch config as the power-on
+// defaults
+void settings_save_defaults();
 
 int settings_get_startup_mode();
 bool settings_is_led_tracking_enabled();
 uint8_t settings_get_midi_channel();
 uint8_t settings_get_midi_controller();
+bool settings_are_midi_gestures_enabled();
 
 void settings_set_startup_mode(int mode);
 void settings_set_led_tracking_enabled(bool enabled);
 void settings_set_midi(uint8_t ch, uint8_t ctl);
+void settings_set_midi_gestures_enabled(bool enabled);
 
 #endif
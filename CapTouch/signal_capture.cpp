@@ -0,0 +1,170 @@
+#include "signal_capture.h"
+
+#include <Arduino.h>
+
+#define DELTA_LIMIT   2047
+
+typedef struct channel_acc {
+  int32_t sum;
+  uint32_t sum_sq;
+  int16_t min;
+  int16_t max;
+} channel_acc_t;
+
+static uint16_t requests[SIGNAL_CAPTURE_CLIENTS];
+static uint8_t slider_only_clients;
+static uint16_t interval;
+static bool slider_only;
+static unsigned long last_request_at;
+static bool requested;
+static bool requested_slider_only;
+
+static cap_touch_raw_t latest;
+static int16_t ring[SIGNAL_CAPTURE_DEPTH][CAP_TOUCH_CHANNEL_COUNT];
+static uint8_t ring_head;
+static uint32_t frames;
+static uint32_t slider_frames;
+
+static channel_acc_t acc[CAP_TOUCH_CHANNEL_COUNT];
+static uint16_t acc_count;
+
+static int16_t delta_of(uint8_t channel) {
+  int32_t d = (int32_t)latest.reference[channel] - latest.signal[channel];
+  if (d > DELTA_LIMIT) {
+    d = DELTA_LIMIT;
+  } else if (d < -DELTA_LIMIT) {
+    d = -DELTA_LIMIT;
+  }
+  return d;
+}
+
+static void accumulate() {
+  // Min/max start over whenever the rest decays, so peak-to-peak follows
+  // the same window rather than holding the worst spike for ever
+  bool restart = acc_count == 0;
+  if (acc_count == SIGNAL_CAPTURE_WINDOW) {
+    for (int i = 0; i < CAP_TOUCH_CHANNEL_COUNT; ++i) {
+      acc[i].sum /= 2;
+      acc[i].sum_sq /= 2;
+    }
+    acc_count /= 2;
+    restart = true;
+  }
+
+  int16_t *row = ring[ring_head];
+  for (int i = 0; i < CAP_TOUCH_CHANNEL_COUNT; ++i) {
+    int16_t d = delta_of(i);
+    row[i] = d;
+    acc[i].sum += d;
+    acc[i].sum_sq += (int32_t)d * d;
+    if (restart || d < acc[i].min) {
+      acc[i].min = d;
+    }
+    if (restart || d > acc[i].max) {
+      acc[i].max = d;
+    }
+  }
+  acc_count++;
+
+  ring_head = (ring_head + 1) % SIGNAL_CAPTURE_DEPTH;
+  frames++;
+}
+
+void signal_capture_tick() {
+  if (requested) {
+    if (cap_touch_read_raw(&latest)) {
+      requested = false;
+      slider_frames++;
+      if (!requested_slider_only) {
+        accumulate();
+      }
+    } else if (millis() - last_request_at > interval) {
+      // Lost (bus error or reset); try again
+      requested = false;
+    }
+    return;
+  }
+
+  if (interval == 0 || (millis() - last_request_at) < interval) {
+    return;
+  }
+
+  if (cap_touch_request_raw(slider_only)) {
+    requested = true;
+    requested_slider_only = slider_only;
+    last_request_at = millis();
+  }
+}
+
+void signal_capture_request(uint8_t client, uint16_t ms, bool only_slider) {
+  requests[client] = ms;
+  if (ms && only_slider) {
+    slider_only_clients |= (1 << client);
+  } else {
+    slider_only_clients &= ~(1 << client);
+  }
+
+  interval = 0;
+  slider_only = true;
+  for (uint8_t i = 0; i < SIGNAL_CAPTURE_CLIENTS; ++i) {
+    if (requests[i] == 0) {
+      continue;
+    }
+    if (interval == 0 || requests[i] < interval) {
+      interval = requests[i];
+    }
+    if (!(slider_only_clients & (1 << i))) {
+      slider_only = false;
+    }
+  }
+}
+
+uint16_t signal_capture_get_interval() {
+  return interval;
+}
+
+void signal_capture_reset() {
+  memset(acc, 0, sizeof(acc));
+  acc_count = 0;
+  frames = 0;
+}
+
+uint32_t signal_capture_frames() {
+  return frames;
+}
+
+uint32_t signal_capture_slider_frames() {
+  return slider_frames;
+}
+
+const cap_touch_raw_t* signal_capture_latest() {
+  return &latest;
+}
+
+int16_t signal_capture_delta(uint8_t channel) {
+  return delta_of(channel);
+}
+
+void signal_capture_get_stats(uint8_t channel, signal_stats_t *out) {
+  if (acc_count == 0) {
+    memset(out, 0, sizeof(*out));
+    return;
+  }
+
+  const channel_acc_t *a = &acc[channel];
+  int32_t mean = a->sum / acc_count;
+  int32_t variance = (int32_t)(a->sum_sq / acc_count) - (mean * mean);
+  out->mean = mean;
+  out->variance = (variance < 0) ? 0 : (variance > 0xFFFF) ? 0xFFFF : variance;
+  out->min = a->min;
+  out->max = a->max;
+}
+
+uint8_t signal_capture_history_length() {
+  return (frames < SIGNAL_CAPTURE_DEPTH) ? frames : SIGNAL_CAPTURE_DEPTH;
+}
+
+const int16_t* signal_capture_history_frame(uint8_t ix) {
+  uint8_t oldest = (ring_head + SIGNAL_CAPTURE_DEPTH - signal_capture_history_length()) % SIGNAL_CAPTURE_DEPTH;
+  return ring[(oldest + ix) % SIGNAL_CAPTURE_DEPTH];
+}
@@ -0,0 +1,62 @@
+#ifndef SIGNAL_CAPTURE_H
+#define SIGNAL_CAPTURE_H
+
+#include <stdint.h>
+#include "cap_touch.h"
+
+// Signal capture
+// --------------
+// Periodically burst-reads per-key signal/reference from the cap touch IC,
+// keeps the most recent deltas in a ring buffer and maintains running delta
+// statistics per channel (see CAP_TOUCH_CHANNEL_COUNT for channel order).
+// Statistics are decayed by halving once SIGNAL_CAPTURE_WINDOW samples have
+// been taken so they follow slow changes; min/max start over at the same
+// point.
+//
+// Each client asks for its own interval and capture runs at the shortest
+// one asked for, so one client going away doesn't leave the others' rate
+// behind. If every client asking only wants the slider keys, just those are
+// read; such frames update the latest values (pads read 0) but not the
+// history or statistics, and only signal_capture_slider_frames() counts
+// them.
+
+#define SIGNAL_CAPTURE_DEPTH      8
+#define SIGNAL_CAPTURE_WINDOW     512
+
+#define SIGNAL_CAPTURE_CONSOLE      0
+#define SIGNAL_CAPTURE_SLIDER       1
+#define SIGNAL_CAPTURE_PROXIMITY    2
+#define SIGNAL_CAPTURE_AUTO_TUNE    3
+#define SIGNAL_CAPTURE_DRIFT        4
+#define SIGNAL_CAPTURE_KEY_FILTER   5
+#define SIGNAL_CAPTURE_CLIENTS      6
+
+typedef struct signal_stats {
+  int16_t mean;
+  uint16_t variance;
+  int16_t min;
+  int16_t max;
+} signal_stats_t;
+
+void signal_capture_tick();
+
+// 0 withdraws the client's request
+void signal_capture_request(uint8_t client, uint16_t ms, bool slider_only);
+
+// What capture is running at, 0 if off
+uint16_t signal_capture_get_interval();
+
+void signal_capture_reset();
+// Frames in the history and statistics
+uint32_t signal_capture_frames();
+// Frames that refreshed the slider keys: all of them, slider-only or not
+uint32_t signal_capture_slider_frames();
+const cap_touch_raw_t* signal_capture_latest();
+int16_t signal_capture_delta(uint8_t channel);
+void signal_capture_get_stats(uint8_t channel, signal_stats_t *out);
+
+// Delta history, oldest (0) first; each frame is CAP_TOUCH_CHANNEL_COUNT long
+uint8_t signal_capture_history_length();
+const int16_t* signal_capture_history_frame(uint8_t ix);
+
+#endif
@@ -0,0 +1,90 @@
+#include "slider_engine.h"
+
+#include <Arduino.h>
+#include "cap_touch.h"
+#include "signal_capture.h"
+
+#define FIRST_CHANNEL   CAP_TOUCH_PAD_COUNT
+#define KEY_SPACING     (CAP_TOUCH_SLIDER_MAX / (CAP_TOUCH_SLIDER_KEY_COUNT - 1))
+
+static bool enabled;
+static bool touched;
+static int position = -1;
+static uint32_t last_frame;
+static unsigned long last_frame_at;
+
+void slider_engine_set_enabled(bool on) {
+  enabled = on;
+  touched = false;
+  position = -1;
+  last_frame = signal_capture_slider_frames();
+  last_frame_at = millis();
+
+  signal_capture_request(SIGNAL_CAPTURE_SLIDER, on ? SLIDER_ENGINE_INTERVAL_MS : 0, true);
+}
+
+bool slider_engine_is_enabled() {
+  return enabled;
+}
+
+// Centroid of the key deltas, after subtracting the weakest so the far key
+// doesn't pull the position towards the middle
+static int interpolate() {
+  int16_t d[CAP_TOUCH_SLIDER_KEY_COUNT];
+  int16_t floor = INT16_MAX;
+  for (int i = 0; i < CAP_TOUCH_SLIDER_KEY_COUNT; ++i) {
+    d[i] = signal_capture_delta(FIRST_CHANNEL + i);
+    if (d[i] < floor) {
+      floor = d[i];
+    }
+  }
+
+  long sum = 0, moment = 0;
+  for (int i = 0; i < CAP_TOUCH_SLIDER_KEY_COUNT; ++i) {
+    long w = d[i] - floor;
+    sum += w;
+    moment += w * (i * KEY_SPACING);
+  }
+  if (sum == 0) {
+    return CAP_TOUCH_SLIDER_MAX / 2;
+  }
+
+  // Same orientation as the chip's position
+  return CAP_TOUCH_SLIDER_MAX - (int)(moment / sum);
+}
+
+static void process_frame() {
+  long total = 0;
+  for (int i = 0; i < CAP_TOUCH_SLIDER_KEY_COUNT; ++i) {
+    int16_t d = signal_capture_delta(FIRST_CHANNEL + i);
+    if (d > 0) {
+      total += d;
+    }
+  }
+
+  if (touched) {
+    touched = total >= SLIDER_ENGINE_RELEASE_DELTA;
+  } else {
+    touched = total >= SLIDER_ENGINE_TOUCH_DELTA;
+  }
+
+  position = touched ? interpolate() : -1;
+}
+
+int slider_engine_update(int slider) {
+  // The centroid only makes sense for a linear slider
+  if (!enabled || cap_touch_slider_mode() != CAP_TOUCH_SLIDER_LINEAR) {
+    return slider;
+  }
+
+  uint32_t frames = signal_capture_slider_frames();
+  if (frames != last_frame) {
+    last_frame = frames;
+    last_frame_at = millis();
+    process_frame();
+  } else if ((millis() - last_frame_at) > SLIDER_ENGINE_STALE_MS) {
+    return slider;
+  }
+
+  return position;
+}
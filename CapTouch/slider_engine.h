@@ -0,0 +1,29 @@
+#ifndef SLIDER_ENGINE_H
+#define SLIDER_ENGINE_H
+
+#include <stdint.h>
+
+// Slider engine
+// -------------
+// Optional firmware replacement for the chip's 8-bit slider position.
+// Interpolates position from the deltas of the three slider keys (taken
+// from signal capture, which reads at least those keys every
+// SLIDER_ENGINE_INTERVAL_MS while the engine is on) to the full
+// CAP_TOUCH_SLIDER_MAX range.
+//
+// Touch is decided from the summed slider key deltas with hysteresis
+// between the touch and release thresholds. If capture stops delivering
+// frames the chip's own position is used until it resumes.
+
+#define SLIDER_ENGINE_INTERVAL_MS     16
+#define SLIDER_ENGINE_STALE_MS        (SLIDER_ENGINE_INTERVAL_MS * 4)
+#define SLIDER_ENGINE_TOUCH_DELTA     30
+#define SLIDER_ENGINE_RELEASE_DELTA   18
+
+void slider_engine_set_enabled(bool enabled);
+bool slider_engine_is_enabled();
+
+// Takes the chip's slider position; returns the one to use
+int slider_engine_update(int slider);
+
+#endif
@@ -0,0 +1,115 @@
+#include "slider_filter.h"
+
+#include <Arduino.h>
+
+static slider_filter_config_t config = {
+  SLIDER_FILTER_DEFAULT_SMOOTHING,
+  SLIDER_FILTER_DEFAULT_DEADBAND,
+  SLIDER_FILTER_DEFAULT_HYSTERESIS
+};
+
+static slider_filter_stats_t stats;
+static uint32_t window_base;
+static unsigned long window_started_at;
+
+static int raw_prev = -1;
+static int reported = -1;
+static int8_t last_dir;
+static unsigned long last_step_at;
+
+// Filtered position, 24.8 fixed point
+static long filtered;
+
+void slider_filter_init() {
+  raw_prev = -1;
+  reported = -1;
+  last_dir = 0;
+  window_started_at = millis();
+}
+
+void slider_filter_get_config(slider_filter_config_t *out) {
+  *out = config;
+}
+
+void slider_filter_set_config(const slider_filter_config_t *in) {
+  config = *in;
+  if (config.smoothing > SLIDER_FILTER_MAX_SMOOTHING) {
+    config.smoothing = SLIDER_FILTER_MAX_SMOOTHING;
+  }
+}
+
+static void update_rate() {
+  unsigned long now = millis();
+  if ((now - window_started_at) >= 1000) {
+    stats.suppressed_per_sec = stats.suppressed - window_base;
+    window_base = stats.suppressed;
+    window_started_at = now;
+  }
+}
+
+static int filter(int slider) {
+  // Release reports immediately
+  if (slider < 0) {
+    reported = -1;
+    return reported;
+  }
+
+  // So does a new touch, from where the finger landed
+  long target = (long)slider << 8;
+  if (reported < 0) {
+    filtered = target;
+    reported = slider;
+    last_dir = 0;
+    return reported;
+  }
+
+  // Stepped on a timer rather than per call so the time constant doesn't
+  // depend on how fast the main loop runs
+  unsigned long now = millis();
+  if (abs(slider - (int)(filtered >> 8)) >= SLIDER_FILTER_SNAP) {
+    filtered = target;
+  } else if ((now - last_step_at) >= SLIDER_FILTER_STEP_MS) {
+    filtered += (target - filtered) >> config.smoothing;
+    last_step_at = now;
+  }
+
+  int pos = (filtered + 128) >> 8;
+  int delta = pos - reported;
+  int8_t dir = (delta > 0) ? 1 : -1;
+  int threshold = config.deadband;
+  if (last_dir != 0 && dir != last_dir) {
+    threshold += config.hysteresis;
+  }
+
+  if (delta != 0 && abs(delta) > threshold) {
+    reported = pos;
+    last_dir = dir;
+  }
+  return reported;
+}
+
+int slider_filter_apply(int slider) {
+  int prev = reported;
+  int out = filter(slider);
+
+  if (slider != raw_prev) {
+    stats.changes++;
+    if (out == prev) {
+      stats.suppressed++;
+    }
+    raw_prev = slider;
+  }
+
+  update_rate();
+  return out;
+}
+
+void slider_filter_get_stats(slider_filter_stats_t *out) {
+  *out = stats;
+}
+
+void slider_filter_reset_stats() {
+  memset(&stats, 0, sizeof(stats));
+  window_base = 0;
+  window_started_at = millis();
+}
@@ -0,0 +1,50 @@
+#ifndef SLIDER_FILTER_H
+#define SLIDER_FILTER_H
+
+#include <stdint.h>
+#include "cap_touch.h"
+
+// Slider filter
+// -------------
+// Sits between acquisition and the modes so a resting finger doesn't turn
+// into a stream of one-count position changes (and USB packets).
+//
+// smoothing : IIR filter strength; every SLIDER_FILTER_STEP_MS the filtered
+//             position moves 1/2^smoothing of the way to the raw one
+//             (0 = off)
+// deadband  : changes of up to this many counts from the last reported
+//             position are ignored
+// hysteresis: extra counts needed to reverse direction
+//
+// Touch and release are passed through immediately, and a raw move larger
+// than SLIDER_FILTER_SNAP skips the smoothing, so the filter only acts on
+// small movements and adds no lag to deliberate ones.
+
+#define SLIDER_FILTER_MAX_SMOOTHING   7
+#define SLIDER_FILTER_SNAP            (CAP_TOUCH_SLIDER_MAX / 10)
+#define SLIDER_FILTER_STEP_MS         10
+
+#define SLIDER_FILTER_DEFAULT_SMOOTHING   2
+#define SLIDER_FILTER_DEFAULT_DEADBAND    16
+#define SLIDER_FILTER_DEFAULT_HYSTERESIS  32
+
+typedef struct __attribute__ ((packed)) slider_filter_config {
+  uint8_t smoothing;
+  uint8_t deadband;
+  uint8_t hysteresis;
+} slider_filter_config_t;
+
+typedef struct slider_filter_stats {
+  uint32_t changes;       // raw position changes seen
+  uint32_t suppressed;    // ... that didn't change the reported position
+  uint16_t suppressed_per_sec;  // over the last full second
+} slider_filter_stats_t;
+
+void slider_filter_init();
+void slider_filter_get_config(slider_filter_config_t *out);
+void slider_filter_set_config(const slider_filter_config_t *in);
+int slider_filter_apply(int slider);
+void slider_filter_get_stats(slider_filter_stats_t *out);
+void slider_filter_reset_stats();
+
+#endif
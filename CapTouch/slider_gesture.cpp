@@ -0,0 +1,78 @@
+#include "slider_gesture.h"
+
+#include <Arduino.h>
+
+static bool touching;
+static bool held;
+static unsigned long touch_at;
+static int start_pos;
+static int last_pos;
+
+// Start of the current speed window, and the fastest window seen
+static unsigned long window_at;
+static int window_pos;
+static int peak_speed;
+
+void slider_gesture_reset() {
+  touching = false;
+}
+
+static void sample_speed(int slider, unsigned long now) {
+  unsigned long dt = now - window_at;
+  if (dt < SLIDER_GESTURE_WINDOW_MS) {
+    return;
+  }
+  int speed = abs(slider - window_pos) / (int)dt;
+  if (speed > peak_speed) {
+    peak_speed = speed;
+  }
+  window_at = now;
+  window_pos = slider;
+}
+
+static uint8_t released(unsigned long now) {
+  if (held) {
+    return SLIDER_GESTURE_NONE;
+  }
+
+  int distance = last_pos - start_pos;
+  if (abs(distance) <= SLIDER_GESTURE_STILL_MAX) {
+    return ((now - touch_at) < SLIDER_GESTURE_TAP_MS) ? SLIDER_GESTURE_TAP : SLIDER_GESTURE_NONE;
+  }
+  if (abs(distance) < SLIDER_GESTURE_SWIPE_MIN) {
+    return SLIDER_GESTURE_NONE;
+  }
+
+  if (peak_speed >= SLIDER_GESTURE_FLICK_SPEED) {
+    return (distance > 0) ? SLIDER_GESTURE_FLICK_UP : SLIDER_GESTURE_FLICK_DOWN;
+  }
+  return (distance > 0) ? SLIDER_GESTURE_SWIPE_UP : SLIDER_GESTURE_SWIPE_DOWN;
+}
+
+uint8_t slider_gesture_update(int slider, unsigned long now) {
+  if (slider < 0) {
+    if (!touching) {
+      return SLIDER_GESTURE_NONE;
+    }
+    touching = false;
+    return released(now);
+  }
+
+  if (!touching) {
+    touching = true;
+    held = false;
+    touch_at = now;
+    start_pos = slider;
+    window_at = now;
+    window_pos = slider;
+    peak_speed = 0;
+  }
+  last_pos = slider;
+  sample_speed(slider, now);
+
+  if (!held && abs(slider - start_pos) <= SLIDER_GESTURE_STILL_MAX && (now - touch_at) >= SLIDER_GESTURE_HOLD_MS) {
+    held = true;
+    return SLIDER_GESTURE_HOLD;
+  }
+  return SLIDER_GESTURE_NONE;
+}
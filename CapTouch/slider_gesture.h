@@ -0,0 +1,44 @@
+#ifndef SLIDER_GESTURE_H
+#define SLIDER_GESTURE_H
+
+#include <stdint.h>
+#include "cap_touch.h"
+
+// Slider gestures
+// ---------------
+// Recognises gestures from the stream of slider positions. State is a fixed
+// handful of words; each update is a few comparisons, so it runs on every
+// pass of the main loop.
+//
+// tap  : short touch that barely moves
+// hold : touch that barely moves for SLIDER_GESTURE_HOLD_MS (reported
+//        while still touching; the release then reports nothing)
+// swipe: touch that travels at least SLIDER_GESTURE_SWIPE_MIN
+// flick: swipe whose fastest window reaches SLIDER_GESTURE_FLICK_SPEED
+//
+// Up/down follow the slider position (up = increasing).
+
+#define SLIDER_GESTURE_NONE         0
+#define SLIDER_GESTURE_TAP          1
+#define SLIDER_GESTURE_HOLD         2
+#define SLIDER_GESTURE_SWIPE_UP     3
+#define SLIDER_GESTURE_SWIPE_DOWN   4
+#define SLIDER_GESTURE_FLICK_UP     5
+#define SLIDER_GESTURE_FLICK_DOWN   6
+
+#define SLIDER_GESTURE_TAP_MS       250
+#define SLIDER_GESTURE_HOLD_MS      600
+#define SLIDER_GESTURE_STILL_MAX    (CAP_TOUCH_SLIDER_MAX / 20)
+#define SLIDER_GESTURE_SWIPE_MIN    (CAP_TOUCH_SLIDER_MAX / 4)
+
+// Speed in slider counts per ms, measured over SLIDER_GESTURE_WINDOW_MS
+#define SLIDER_GESTURE_WINDOW_MS    32
+#define SLIDER_GESTURE_FLICK_SPEED  (CAP_TOUCH_SLIDER_MAX / 200)
+
+void slider_gesture_reset();
+
+// Takes the slider position (-1 if untouched) and the time it was sampled;
+// returns a gesture or SLIDER_GESTURE_NONE
+uint8_t slider_gesture_update(int slider, unsigned long now);
+
+#endif
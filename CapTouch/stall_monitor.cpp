@@ -0,0 +1,181 @@
+#include "stall_monitor.h"
+
+#include <Arduino.h>
+#include <avr/wdt.h>
+#include <util/atomic.h>
+#include "scheduler.h"
+
+#define STALL_MAGIC             0x5354
+
+// The core's bootloader jump (a 1200 baud touch, for uploads) leaves this
+// key and arms its own short watchdog
+#define BOOT_MAGIC_KEY          0x7777
+#define BOOT_MAGIC_KEY_POS      0x0800
+
+#define WDT_SETUP_BITS          ((1 << WDE) | (1 << WDP3) | (1 << WDP2) | (1 << WDP1) | (1 << WDP0))
+
+typedef struct saved_record {
+  uint16_t magic;
+  stall_record_t record;
+  uint8_t check;
+} saved_record_t;
+
+// Well past what each stage normally takes (see sched), so only real
+// stalls count. The console's covers a full screen of output.
+static const uint32_t deadlines_us[SCHEDULER_STAGE_COUNT] = {
+  2000,     // scan
+  1000,     // buttons
+  2000,     // leds
+  20000     // console
+};
+
+static saved_record_t saved __attribute__ ((section (".noinit")));
+static bool previous;
+
+static volatile uint8_t stage = 0xFF;
+static volatile uint8_t mark;
+static volatile unsigned long entered_at;
+static uint32_t allowed_us;             // this run's deadline, if raised
+static uint8_t armed;                   // WDT_SETUP_BITS as we last set them, 0 if not ours
+static bool long_wdto;
+static uint16_t overruns[SCHEDULER_STAGE_COUNT];
+
+static uint8_t checksum() {
+  const uint8_t *p = (const uint8_t*)&saved;
+  uint8_t c = 0xA5;
+  for (uint8_t i = 0; i < offsetof(saved_record_t, check); ++i) {
+    c = (c << 1 | c >> 7) ^ p[i];
+  }
+  return c;
+}
+
+static void save(uint8_t kind, uint32_t us) {
+  saved.magic = STALL_MAGIC;
+  saved.record.kind = kind;
+  saved.record.stage = stage;
+  saved.record.mark = mark;
+  saved.record.us = us;
+  saved.record.at_ms = millis();
+  saved.check = checksum();
+  previous = false;
+}
+
+void stall_monitor_init() {
+  // Still running at the shortest timeout after a watchdog reset, unless
+  // the bootloader has already seen to it
+  MCUSR = 0;
+  wdt_disable();
+
+  previous = (saved.magic == STALL_MAGIC) && (saved.check == checksum());
+  if (!previous) {
+    memset(&saved, 0, sizeof(saved));
+  }
+}
+
+static void wdt_arm(uint8_t timeout) {
+  wdt_enable(timeout);
+  WDTCSR |= (1 << WDIE);
+  armed = WDTCSR & WDT_SETUP_BITS;
+}
+
+// Once anything else has set the watchdog up (the bootloader jump, or a
+// wdt_disable()) it's theirs: kicking or re-arming it would hold off their
+// reset, and WDIE on a watchdog that isn't ours would record false stalls
+static bool wdt_ours() {
+  if (armed && (*(volatile uint16_t*)BOOT_MAGIC_KEY_POS == BOOT_MAGIC_KEY || (WDTCSR & WDT_SETUP_BITS) != armed)) {
+    armed = 0;
+  }
+  return armed;
+}
+
+void stall_monitor_arm() {
+  wdt_arm(STALL_MONITOR_WDTO);
+}
+
+void stall_monitor_enter(uint8_t id) {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    stage = id;
+    mark = 0;
+    entered_at = micros();
+  }
+  if (wdt_ours()) {
+    wdt_reset();
+    // Cleared by hardware when the interrupt was taken
+    WDTCSR |= (1 << WDIE);
+  }
+}
+
+void stall_monitor_expect(uint32_t us) {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    uint32_t allow = (micros() - entered_at) + us;
+    if (allow > allowed_us) {
+      allowed_us = allow;
+    }
+  }
+  if (!long_wdto && wdt_ours()) {
+    long_wdto = true;
+    wdt_arm(STALL_MONITOR_LONG_WDTO);
+  }
+}
+
+void stall_monitor_leave(uint32_t us) {
+  if (long_wdto) {
+    long_wdto = false;
+    if (wdt_ours()) {
+      wdt_arm(STALL_MONITOR_WDTO);
+    }
+  }
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    uint32_t deadline = (stage < SCHEDULER_STAGE_COUNT) ? deadlines_us[stage] : 0;
+    if (allowed_us > deadline) {
+      deadline = allowed_us;
+    }
+    allowed_us = 0;
+    if (stage < SCHEDULER_STAGE_COUNT && us > deadline) {
+      if (overruns[stage] != 0xFFFF) {
+        overruns[stage]++;
+      }
+      save(STALL_OVERRUN, us);
+    }
+    stage = 0xFF;
+  }
+}
+
+void stall_monitor_mark(uint8_t m) {
+  mark = m;
+}
+
+uint32_t stall_monitor_deadline(uint8_t id) {
+  return deadlines_us[id];
+}
+
+uint16_t stall_monitor_overruns(uint8_t id) {
+  return overruns[id];
+}
+
+void stall_monitor_get_record(stall_record_t *out, bool *prev) {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    *out = saved.record;
+    *prev = previous;
+  }
+}
+
+bool stall_monitor_watchdog_reset() {
+  return previous && saved.record.kind == STALL_WATCHDOG;
+}
+
+void stall_monitor_reset() {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    memset(&saved, 0, sizeof(saved));
+    memset(overruns, 0, sizeof(overruns));
+    previous = false;
+  }
+}
+
+// Half way to the reset: note where we're stuck. If the stage does come
+// back in time, leaving it overwrites this with the overrun.
+ISR(WDT_vect) {
+  if (armed) {
+    save(STALL_WATCHDOG, micros() - entered_at);
+  }
+}
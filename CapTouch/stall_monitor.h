@@ -0,0 +1,64 @@
+#ifndef STALL_MONITOR_H
+#define STALL_MONITOR_H
+
+#include <stdint.h>
+
+// Stall monitor
+// -------------
+// Gives each scheduler stage a deadline and records the last one that ran
+// past it: which stage, where in it (its mark), and for how long. The
+// watchdog covers the stages that never come back: it's kicked as each
+// stage starts, interrupts first so the record can be written, and resets
+// the board on the timeout after that.
+//
+// The watchdog is only the monitor's until something else sets it up: after
+// the core's bootloader jump (1200 baud touch) or a wdt_disable() it's left
+// alone, and stalls are then only caught by their deadlines.
+//
+// The record lives in .noinit RAM, so it's still there after a watchdog
+// reset (the bootloader clears MCUSR, so the record itself is what says
+// the last reset was one). A power cycle loses it.
+
+#define STALL_MONITOR_WDTO      WDTO_500MS
+#define STALL_MONITOR_LONG_WDTO WDTO_2S
+
+#define STALL_NONE              0
+#define STALL_OVERRUN           1
+#define STALL_WATCHDOG          2
+
+// Marks within the scan stage; the console marks the command it's running
+// (handler index + 1)
+#define STALL_MARK_ACQUIRE      0
+#define STALL_MARK_EMIT         1
+
+typedef struct stall_record {
+  uint8_t kind;
+  uint8_t stage;
+  uint8_t mark;
+  uint32_t us;              // time in the stage, up to the record
+  uint32_t at_ms;           // uptime when it was recorded
+} stall_record_t;
+
+// First thing in setup(); the watchdog isn't running until stall_monitor_arm()
+void stall_monitor_init();
+void stall_monitor_arm();
+
+// From the scheduler, around each stage
+void stall_monitor_enter(uint8_t stage);
+void stall_monitor_leave(uint32_t us);
+
+void stall_monitor_mark(uint8_t mark);
+
+// For work known to be slow (EEPROM writes): allows the current stage us
+// more from now, and the watchdog STALL_MONITOR_LONG_WDTO, for this run only
+void stall_monitor_expect(uint32_t us);
+
+uint32_t stall_monitor_deadline(uint8_t stage);
+uint16_t stall_monitor_overruns(uint8_t stage);
+
+// previous is set if the record was written before the last reset
+void stall_monitor_get_record(stall_record_t *out, bool *previous);
+bool stall_monitor_watchdog_reset();
+void stall_monitor_reset();
+
+#endif
@@ -0,0 +1,60 @@
+#include "touch_history.h"
+
+#include <Arduino.h>
+
+#define SLIDER_SHIFT    (CAP_TOUCH_SLIDER_BITS - 8)
+
+static touch_event_t ring[TOUCH_HISTORY_DEPTH];
+static uint8_t ring_head;
+static uint32_t total;
+
+// Last state seen at each stage
+static cap_touch_buttons_t last_buttons[2];
+static bool last_touched[2];
+
+static void push(uint8_t event, uint8_t value, uint32_t us) {
+  touch_event_t *e = &ring[ring_head];
+  e->us = us;
+  e->event = event;
+  e->value = value;
+  ring_head = (ring_head + 1) % TOUCH_HISTORY_DEPTH;
+  total++;
+}
+
+void touch_history_record(uint8_t stage, cap_touch_buttons_t buttons, int slider, uint32_t us) {
+  cap_touch_buttons_t changed = buttons ^ last_buttons[stage];
+  bool touched = slider >= 0;
+
+  if (changed) {
+    for (uint8_t pad = 0; changed; ++pad, changed >>= 1) {
+      if (changed & 1) {
+        uint8_t kind = (buttons & CAP_TOUCH_PAD_BIT(pad)) ? TOUCH_HISTORY_PAD_DOWN : TOUCH_HISTORY_PAD_UP;
+        push(TOUCH_HISTORY_EVENT(kind, stage, pad), 0, us);
+      }
+    }
+    last_buttons[stage] = buttons;
+  }
+
+  if (touched != last_touched[stage]) {
+    uint8_t kind = touched ? TOUCH_HISTORY_SLIDER_DOWN : TOUCH_HISTORY_SLIDER_UP;
+    push(TOUCH_HISTORY_EVENT(kind, stage, 0), touched ? (slider >> SLIDER_SHIFT) : 0, us);
+    last_touched[stage] = touched;
+  }
+}
+
+void touch_history_clear() {
+  total = 0;
+}
+
+uint8_t touch_history_length() {
+  return (total < TOUCH_HISTORY_DEPTH) ? total : TOUCH_HISTORY_DEPTH;
+}
+
+uint32_t touch_history_total() {
+  return total;
+}
+
+const touch_event_t* touch_history_get(uint8_t ix) {
+  uint8_t oldest = (ring_head + TOUCH_HISTORY_DEPTH - touch_history_length()) % TOUCH_HISTORY_DEPTH;
+  return &ring[(oldest + ix) % TOUCH_HISTORY_DEPTH];
+}
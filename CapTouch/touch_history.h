@@ -0,0 +1,55 @@
+#ifndef TOUCH_HISTORY_H
+#define TOUCH_HISTORY_H
+
+#include <stdint.h>
+#include "cap_touch.h"
+
+// Touch history
+// -------------
+// Every pad and slider edge, timestamped with micros(), in a RAM ring of the
+// last TOUCH_HISTORY_DEPTH events; the oldest are overwritten. Edges are
+// recorded at two stages:
+//
+// read: as decoded from the controllers, stamped with the time the status
+//       read completed
+// emit: as handed to the current mode, stamped on the way out
+//
+// so the gap between a read edge and the matching emit edge is the
+// firmware's latency for it. Recording is an XOR against the previous state
+// and only touches the ring when something changed, so it stays on.
+//
+// Events are 6 bytes: timestamp, then an event byte (kind in bits 7-6,
+// stage in bit 5, pad in bits 4-0) and a value byte (slider position
+// >> (CAP_TOUCH_SLIDER_BITS - 8) for slider events, else 0).
+
+#define TOUCH_HISTORY_DEPTH     32
+
+#define TOUCH_HISTORY_READ      0
+#define TOUCH_HISTORY_EMIT      1
+
+#define TOUCH_HISTORY_PAD_UP        0
+#define TOUCH_HISTORY_PAD_DOWN      1
+#define TOUCH_HISTORY_SLIDER_UP     2
+#define TOUCH_HISTORY_SLIDER_DOWN   3
+
+#define TOUCH_HISTORY_EVENT(kind, stage, pad)   (((kind) << 6) | ((stage) << 5) | (pad))
+#define TOUCH_HISTORY_KIND(event)               ((event) >> 6)
+#define TOUCH_HISTORY_STAGE(event)              (((event) >> 5) & 1)
+#define TOUCH_HISTORY_PAD(event)                ((event) & 0x1F)
+
+typedef struct __attribute__ ((packed)) touch_event {
+  uint32_t us;
+  uint8_t event;
+  uint8_t value;
+} touch_event_t;
+
+void touch_history_record(uint8_t stage, cap_touch_buttons_t buttons, int slider, uint32_t us);
+
+void touch_history_clear();
+uint8_t touch_history_length();
+uint32_t touch_history_total();   // events recorded since the last clear
+
+// Oldest (0) first
+const touch_event_t* touch_history_get(uint8_t ix);
+
+#endif
@@ -0,0 +1,76 @@
+#include "touch_queue.h"
+
+#include <Arduino.h>
+#include <util/atomic.h>
+
+#define MASK    (TOUCH_QUEUE_DEPTH - 1)
+
+// Keeps the entry's stores ahead of the index that publishes it
+#define BARRIER()   __asm__ __volatile__ ("" ::: "memory")
+
+static cap_touch_state_t ring[TOUCH_QUEUE_DEPTH];
+static volatile uint8_t head;     // producer's
+static volatile uint8_t tail;     // consumer's
+
+// Producer's
+static cap_touch_state_t last = { 0, -1, false, 0, 0 };
+static touch_queue_stats_t stats;
+
+void touch_queue_put(const cap_touch_state_t *state) {
+  if (state->buttons == last.buttons && state->slider == last.slider && state->proximity == last.proximity) {
+    return;
+  }
+
+  uint8_t h = head;
+  uint8_t used = (uint8_t)(h - tail);
+  if (used >= TOUCH_QUEUE_DEPTH) {
+    if (stats.overflows != 0xFFFF) {
+      stats.overflows++;
+    }
+    return;
+  }
+
+  ring[h & MASK] = *state;
+  BARRIER();
+  head = h + 1;
+
+  last = *state;
+  stats.queued++;
+  if (used + 1 > stats.high_water) {
+    stats.high_water = used + 1;
+  }
+}
+
+bool touch_queue_get(cap_touch_state_t *out) {
+  uint8_t t = tail;
+  if (t == head) {
+    return false;
+  }
+  BARRIER();
+  *out = ring[t & MASK];
+  BARRIER();
+  tail = t + 1;
+  return true;
+}
+
+void touch_queue_clear(const cap_touch_state_t *state) {
+  tail = head;
+  last = *state;
+}
+
+uint8_t touch_queue_length() {
+  return head - tail;
+}
+
+void touch_queue_get_stats(touch_queue_stats_t *out) {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    *out = stats;
+  }
+}
+
+void touch_queue_reset_stats() {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    memset(&stats, 0, sizeof(stats));
+    stats.high_water = head - tail;
+  }
+}
@@ -0,0 +1,43 @@
+#ifndef TOUCH_QUEUE_H
+#define TOUCH_QUEUE_H
+
+#include <stdint.h>
+#include "cap_touch.h"
+
+// Touch queue
+// -----------
+// Decoded touch states on their way from the status read interrupt (see
+// cap_touch_tick()) to the scan stage, in a single producer/single consumer
+// ring. The producer only ever writes the head and the consumer only the
+// tail, each a single byte, so neither side locks.
+//
+// Only changes are queued: a state with the same buttons, slider and
+// proximity as the last one queued is skipped. If the ring is full the
+// state is dropped and counted as an overflow but isn't forgotten; it no
+// longer matches the last one queued, so the next put queues the then
+// current state and the consumer never misses the final one (a release,
+// say), only the steps in between.
+
+#define TOUCH_QUEUE_DEPTH       16      // power of 2, at most 128
+
+typedef struct touch_queue_stats {
+  uint32_t queued;
+  uint16_t overflows;
+  uint8_t high_water;       // most entries waiting at once
+} touch_queue_stats_t;
+
+// Producer
+void touch_queue_put(const cap_touch_state_t *state);
+
+// Consumer; false if there's nothing waiting
+bool touch_queue_get(cap_touch_state_t *out);
+
+// Empties the ring and takes state as the one already passed on. Only
+// while the producer is stopped.
+void touch_queue_clear(const cap_touch_state_t *state);
+
+uint8_t touch_queue_length();
+void touch_queue_get_stats(touch_queue_stats_t *out);
+void touch_queue_reset_stats();
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <stdio.h>
+
+// Minimal assertions for the host tests: report and carry on, and the
+// test's exit status says whether any failed
+
+static int check_failures;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+      printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+      check_failures++; \
+    } \
+  } while (0)
+
+static int check_report(const char *name) {
+  printf("%s: %s\n", name, check_failures ? "FAILED" : "ok");
+  return check_failures ? 1 : 0;
+}
+
+#endif
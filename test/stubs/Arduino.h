@@ -0,0 +1,21 @@
+#ifndef Arduino_h
+#define Arduino_h
+
+// Host build stand-in for the Arduino core: just what the modules under
+// test use. Time is the simulated clock in twi_sim.cpp.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#define F_CPU 16000000UL
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef _AVR_INTERRUPT_H_
+#define _AVR_INTERRUPT_H_
+
+// Handlers are plain functions; twi_sim.cpp calls TWI_vect itself and the
+// tests call the others
+#define ISR(vector) extern "C" void vector(void)
+
+#endif
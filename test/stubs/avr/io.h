@@ -0,0 +1,38 @@
+#ifndef _AVR_IO_H_
+#define _AVR_IO_H_
+
+#include <stdint.h>
+
+// ATmega32U4 registers used by the modules under test. TWCR is written
+// through twi_control so the simulated peripheral (twi_sim.cpp) sees every
+// write, as the real one does.
+
+class twi_control {
+public:
+  twi_control &operator=(uint8_t v);
+  twi_control &operator|=(uint8_t v) { return *this = value | v; }
+  twi_control &operator&=(uint8_t v) { return *this = value & v; }
+  operator uint8_t() const { return value; }
+  uint8_t value;
+};
+
+extern twi_control TWCR;
+extern volatile uint8_t TWDR, TWSR, TWBR;
+extern volatile uint8_t PORTD, DDRD, PIND;
+extern volatile uint8_t PORTE, DDRE, PINE;
+extern volatile uint8_t EICRB, EIMSK, EIFR;
+
+#define TWINT   7
+#define TWEA    6
+#define TWSTA   5
+#define TWSTO   4
+#define TWWC    3
+#define TWEN    2
+#define TWIE    0
+
+#define INT6    6
+#define INTF6   6
+#define ISC61   5
+#define ISC60   4
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef _UTIL_ATOMIC_H_
+#define _UTIL_ATOMIC_H_
+
+#include <stdint.h>
+
+// Interrupts are "disabled" while sim_irq_off is nonzero; the simulated
+// peripheral doesn't interrupt then, and takes one it has pending as soon
+// as they're enabled again
+
+extern volatile uint8_t sim_irq_off;
+void sim_irq_enabled();
+
+struct sim_atomic {
+  sim_atomic() { sim_irq_off++; }
+  ~sim_atomic() {
+    if (--sim_irq_off == 0) {
+      sim_irq_enabled();
+    }
+  }
+};
+
+#define ATOMIC_RESTORESTATE   0
+#define ATOMIC_FORCEON        0
+#define ATOMIC_BLOCK(type)    for (sim_atomic _sim_atomic, *_sim_once = &_sim_atomic; _sim_once; _sim_once = 0)
+
+#endif
@@ -0,0 +1,178 @@
+// Status acquisition against simulated QT2120s: how many status reads go
+// to the bus while nothing is happening, and how soon a touch shows. Built
+// with and without CAP_TOUCH_CHANGE_IRQ (test_change, test_poll), and with
+// two controllers (test_change2, test_poll2).
+
+#include <Arduino.h>
+#include <stdio.h>
+#include <util/atomic.h>
+#include "cap_touch.h"
+#include "i2c.h"
+#include "twi_sim.h"
+#include "check.h"
+
+#define QT_ADDR         0x1C
+#define REG_STATUS      2
+
+#if CAP_TOUCH_CHANGE_IRQ && CAP_TOUCH_CONTROLLER_COUNT > 1
+#define TEST_NAME       "test_change2"
+#elif CAP_TOUCH_CHANGE_IRQ
+#define TEST_NAME       "test_change"
+#elif CAP_TOUCH_CONTROLLER_COUNT > 1
+#define TEST_NAME       "test_poll2"
+#else
+#define TEST_NAME       "test_poll"
+#endif
+
+static const uint8_t addrs[CAP_TOUCH_CONTROLLER_COUNT] = CAP_TOUCH_ADDRESSES;
+static twi_sim_slave_t *qts[CAP_TOUCH_CONTROLLER_COUNT];
+static twi_sim_slave_t *qt;
+static cap_touch_state_t state;
+
+void indicators_set_ident(bool on) {
+}
+
+// A millisecond of the sketch: the scheduler tick's interrupt, then the
+// scan stage
+static void run_ms(uint16_t ms) {
+  for (uint16_t i = 0; i < ms; ++i) {
+    twi_sim_advance(1000);
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      cap_touch_tick();
+    }
+    cap_touch_update(&state);
+  }
+}
+
+static uint32_t status_reads(uint8_t ctl = 0) {
+  return qts[ctl]->reads_from[REG_STATUS];
+}
+
+// Default topology: board pad 1 is key 11
+static void touch_pad_1(bool touched) {
+  qt->regs[2] = touched ? 0x01 : 0x00;
+  qt->regs[3] = 0;
+  qt->regs[4] = touched ? (1 << (11 - 8)) : 0;
+#if CAP_TOUCH_CHANGE_IRQ
+  twi_sim_change(qt);
+#endif
+}
+
+static void start() {
+  for (uint8_t i = 0; i < CAP_TOUCH_CONTROLLER_COUNT; ++i) {
+    qts[i] = twi_sim_add(addrs[i]);
+    // The chip's power-on LP_MODE and detect thresholds
+    qts[i]->regs[8] = 2;
+    memset(&qts[i]->regs[16], 10, 12);
+  }
+  qt = qts[0];
+
+  cap_touch_init();
+  run_ms(400);
+  CHECK(cap_touch_reset_state() == CAP_TOUCH_RESET_READY);
+  CHECK(cap_touch_cal_state() == CAP_TOUCH_CAL_IDLE);
+}
+
+// Only the poll reads status while nothing is touched, each controller once
+// per interval however many there are; every tick used to
+static void test_idle() {
+  run_ms(CAP_TOUCH_POLL_INTERVAL_MS);
+  cap_touch_reset_stats();
+  uint32_t before[CAP_TOUCH_CONTROLLER_COUNT];
+  for (uint8_t i = 0; i < CAP_TOUCH_CONTROLLER_COUNT; ++i) {
+    before[i] = status_reads(i);
+  }
+
+  run_ms(1000);
+
+  uint32_t total = 0;
+  for (uint8_t i = 0; i < CAP_TOUCH_CONTROLLER_COUNT; ++i) {
+    uint32_t reads = status_reads(i) - before[i];
+    CHECK(reads >= 1000 / CAP_TOUCH_POLL_INTERVAL_MS - 1);
+    CHECK(reads <= 1000 / CAP_TOUCH_POLL_INTERVAL_MS + 1);
+    total += reads;
+  }
+  cap_touch_stats_t stats;
+  cap_touch_get_stats(&stats);
+  printf("%s: idle, %lu status reads in 1000 ticks, %lu ticks without one\n", TEST_NAME,
+         (unsigned long)total, (unsigned long)stats.reads_skipped);
+  CHECK(stats.reads == total);
+  CHECK(stats.reads_polled == total);
+  CHECK(stats.reads_skipped >= 1000 - total - 1);
+}
+
+#if CAP_TOUCH_CONTROLLER_COUNT > 1 && !CAP_TOUCH_CHANGE_IRQ
+// Without CHANGE a poll reads every controller, back to back in one tick
+static void test_poll_reads_all() {
+  uint32_t first = status_reads(0);
+  for (uint16_t i = 0; i <= CAP_TOUCH_POLL_INTERVAL_MS && status_reads(0) == first; ++i) {
+    uint32_t before = status_reads(CAP_TOUCH_CONTROLLER_COUNT - 1);
+    run_ms(1);
+    if (status_reads(0) != first) {
+      CHECK(status_reads(CAP_TOUCH_CONTROLLER_COUNT - 1) == before + 1);
+    }
+  }
+  CHECK(status_reads(0) == first + 1);
+}
+#endif
+
+// With CHANGE a touch is read on the next tick; without, on the next poll
+static void test_touch() {
+#if CAP_TOUCH_CHANGE_IRQ
+  const uint16_t within_ms = 2;
+#else
+  const uint16_t within_ms = CAP_TOUCH_POLL_INTERVAL_MS + 1;
+#endif
+#if CAP_TOUCH_CHANGE_IRQ
+  uint32_t reads = status_reads();
+#endif
+  touch_pad_1(true);
+  run_ms(within_ms);
+  CHECK(state.buttons == CAP_TOUCH_PAD_BIT(0));
+  CHECK(state.slider == -1);
+#if CAP_TOUCH_CHANGE_IRQ
+  CHECK(status_reads() - reads == 1);
+  CHECK(PINE & (1 << 6));
+#endif
+
+  touch_pad_1(false);
+  run_ms(within_ms);
+  CHECK(state.buttons == 0);
+}
+
+// A failed read is retried straight away, not at the next poll
+static uint16_t bus_nacks() {
+  i2c_stats_t stats;
+  i2c_get_stats(&stats);
+  return stats.nacks;
+}
+
+static void test_retry() {
+  qt->nack = true;
+  uint16_t nacks = bus_nacks();
+  for (uint16_t i = 0; i <= CAP_TOUCH_POLL_INTERVAL_MS && bus_nacks() == nacks; ++i) {
+    run_ms(1);
+  }
+  CHECK(bus_nacks() == nacks + 1);
+
+  qt->nack = false;
+  qt->regs[2] = 0x01;
+  qt->regs[4] = (1 << (11 - 8));
+  uint32_t reads = status_reads();
+  run_ms(2);
+  CHECK(state.buttons == CAP_TOUCH_PAD_BIT(0));
+  CHECK(status_reads() - reads == 1);
+  CHECK(cap_touch_reset_state() == CAP_TOUCH_RESET_READY);
+}
+
+int main() {
+  twi_sim_reset();
+  start();
+  test_idle();
+#if CAP_TOUCH_CONTROLLER_COUNT > 1 && !CAP_TOUCH_CHANGE_IRQ
+  test_poll_reads_all();
+#endif
+  test_touch();
+  test_retry();
+  return check_report(TEST_NAME);
+}
@@ -0,0 +1,288 @@
+// The TWI job queue against the simulated peripheral: transfers, the
+// blocking helpers, and every way a job can end early; and the bus cost of
+// moving cap touch config, which goes over it as one block
+
+#include <Arduino.h>
+#include <util/atomic.h>
+#include "i2c.h"
+#include "cap_touch.h"
+#include "twi_sim.h"
+#include "check.h"
+
+#define QT_ADDR       0x1C
+#define ABSENT_ADDR   0x1D
+
+static int done_calls;
+
+static void on_done(i2c_job_t *job) {
+  done_calls++;
+}
+
+static void test_write() {
+  twi_sim_slave_t *qt = twi_sim_add(QT_ADDR);
+  uint8_t buf[2] = { 0xAA, 0x55 };
+  i2c_job_t job = { QT_ADDR, 8, I2C_WRITE, 2, buf, on_done, I2C_IDLE };
+
+  done_calls = 0;
+  CHECK(i2c_submit(&job));
+  CHECK(I2C_PENDING(&job));
+  twi_sim_run();
+  CHECK(job.status == I2C_DONE);
+  CHECK(done_calls == 1);
+  CHECK(qt->regs[8] == 0xAA && qt->regs[9] == 0x55);
+  CHECK(qt->writes == 1);
+}
+
+static void test_read() {
+  twi_sim_slave_t *qt = twi_sim_add(QT_ADDR);
+  qt->regs[2] = 1;
+  qt->regs[3] = 2;
+  qt->regs[4] = 3;
+  uint8_t buf[3] = { 0 };
+  i2c_job_t job = { QT_ADDR, 2, I2C_READ, 3, buf, on_done, I2C_IDLE };
+
+  done_calls = 0;
+  CHECK(i2c_submit(&job));
+  twi_sim_run();
+  CHECK(job.status == I2C_DONE);
+  CHECK(done_calls == 1);
+  CHECK(buf[0] == 1 && buf[1] == 2 && buf[2] == 3);
+  // NACKed the last byte, so nothing past it was clocked out
+  CHECK(qt->ptr == 5);
+  CHECK(qt->reads == 1 && qt->reads_from[2] == 1);
+
+  // Single byte: NACKed straight away
+  uint8_t one = 0;
+  i2c_job_t single = { QT_ADDR, 4, I2C_READ, 1, &one, NULL, I2C_IDLE };
+  CHECK(i2c_submit(&single));
+  twi_sim_run();
+  CHECK(single.status == I2C_DONE && one == 3);
+}
+
+static void test_blocking() {
+  twi_sim_slave_t *qt = twi_sim_add(QT_ADDR);
+  uint8_t out[3] = { 7, 8, 9 };
+  CHECK(i2c_write(QT_ADDR, 16, out, 3) == I2C_DONE);
+  uint8_t in[3] = { 0 };
+  CHECK(i2c_read(QT_ADDR, 16, in, 3) == I2C_DONE);
+  CHECK(memcmp(in, out, 3) == 0);
+  CHECK(qt->writes == 1 && qt->reads == 1);
+}
+
+static void test_nack() {
+  twi_sim_slave_t *qt = twi_sim_add(QT_ADDR);
+  uint8_t a_buf, b_buf;
+  i2c_job_t a = { ABSENT_ADDR, 2, I2C_READ, 1, &a_buf, on_done, I2C_IDLE };
+  i2c_job_t b = { QT_ADDR, 2, I2C_READ, 1, &b_buf, on_done, I2C_IDLE };
+
+  done_calls = 0;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    CHECK(i2c_submit(&a));
+    CHECK(i2c_submit(&b));
+    CHECK(b.status == I2C_QUEUED);
+  }
+  twi_sim_run();
+  CHECK(a.status == I2C_ERR_NACK);
+  // The next job is started straight after, without waiting for a poll
+  CHECK(b.status == I2C_DONE);
+  CHECK(done_calls == 2);
+
+  // A slave that NACKs its address when it's there
+  qt->nack = true;
+  CHECK(i2c_read(QT_ADDR, 2, &b_buf, 1) == I2C_ERR_NACK);
+
+  i2c_stats_t stats;
+  i2c_get_stats(&stats);
+  CHECK(stats.nacks == 2);
+}
+
+static void test_arbitration_lost() {
+  twi_sim_add(QT_ADDR);
+  uint8_t buf;
+  i2c_job_t job = { QT_ADDR, 2, I2C_READ, 1, &buf, on_done, I2C_IDLE };
+
+  done_calls = 0;
+  CHECK(i2c_submit(&job));
+  twi_sim_fail_next(0x38);
+  twi_sim_run();
+  CHECK(job.status == I2C_ERR_BUS);
+  CHECK(done_calls == 1);
+
+  // The bus is usable again afterwards
+  CHECK(i2c_read(QT_ADDR, 2, &buf, 1) == I2C_DONE);
+
+  i2c_stats_t stats;
+  i2c_get_stats(&stats);
+  CHECK(stats.bus_errors == 1);
+}
+
+// One job active plus I2C_QUEUE_SIZE waiting; a slave holding the bus keeps
+// the first one active while the rest are submitted
+static void test_queue_full_and_timeout() {
+  twi_sim_slave_t *stuck = twi_sim_add(ABSENT_ADDR);
+  twi_sim_slave_t *qt = twi_sim_add(QT_ADDR);
+  stuck->hang = true;
+  uint8_t buf;
+  i2c_job_t hung = { ABSENT_ADDR, 2, I2C_READ, 1, &buf, on_done, I2C_IDLE };
+  i2c_job_t jobs[I2C_QUEUE_SIZE + 1];
+  for (uint8_t i = 0; i < I2C_QUEUE_SIZE + 1; ++i) {
+    jobs[i] = (i2c_job_t){ QT_ADDR, 2, I2C_READ, 1, &buf, NULL, I2C_IDLE };
+  }
+
+  done_calls = 0;
+  CHECK(i2c_submit(&hung));
+  twi_sim_run();
+  CHECK(hung.status == I2C_BUSY);
+  for (uint8_t i = 0; i < I2C_QUEUE_SIZE; ++i) {
+    CHECK(i2c_submit(&jobs[i]));
+  }
+  CHECK(!i2c_submit(&jobs[I2C_QUEUE_SIZE]));
+  CHECK(jobs[I2C_QUEUE_SIZE].status == I2C_IDLE);
+  // Already queued
+  CHECK(!i2c_submit(&jobs[0]));
+  // Empty
+  i2c_job_t empty = { QT_ADDR, 2, I2C_READ, 0, &buf, NULL, I2C_IDLE };
+  CHECK(!i2c_submit(&empty));
+
+  // Nothing moves until the hung job runs out of time
+  twi_sim_advance(I2C_TIMEOUT_US(1) / 2);
+  i2c_poll();
+  CHECK(hung.status == I2C_BUSY);
+  twi_sim_advance(I2C_TIMEOUT_US(1));
+  i2c_poll();
+  CHECK(hung.status == I2C_ERR_TIMEOUT);
+  CHECK(done_calls == 1);
+
+  // ...after which the bus is cleared and the queue drains
+  twi_sim_run();
+  for (uint8_t i = 0; i < I2C_QUEUE_SIZE; ++i) {
+    CHECK(jobs[i].status == I2C_DONE);
+  }
+  CHECK(qt->reads == I2C_QUEUE_SIZE);
+
+  i2c_stats_t stats;
+  i2c_get_stats(&stats);
+  CHECK(stats.timeouts == 1);
+  CHECK(stats.bus_clears == 1);
+}
+
+// A blocking caller behind a hung job waits out its budget, no longer
+static void test_blocked_caller_bounded() {
+  twi_sim_slave_t *stuck = twi_sim_add(ABSENT_ADDR);
+  twi_sim_add(QT_ADDR);
+  stuck->hang = true;
+  uint8_t buf;
+  i2c_job_t hung = { ABSENT_ADDR, 2, I2C_READ, 1, &buf, NULL, I2C_IDLE };
+  CHECK(i2c_submit(&hung));
+
+  unsigned long start = twi_sim_now();
+  CHECK(i2c_read(QT_ADDR, 2, &buf, 1) == I2C_DONE);
+  CHECK(hung.status == I2C_ERR_TIMEOUT);
+  CHECK(twi_sim_now() - start < I2C_TIMEOUT_US(1) + I2C_TIMEOUT_US(1));
+}
+
+void indicators_set_ident(bool on) {
+}
+
+// A millisecond of the sketch: the scheduler tick's interrupt, then the
+// scan stage
+static void run_ms(uint16_t ms) {
+  cap_touch_state_t state;
+  for (uint16_t i = 0; i < ms; ++i) {
+    twi_sim_advance(1000);
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      cap_touch_tick();
+    }
+    cap_touch_update(&state);
+  }
+}
+
+static uint32_t bus_transactions() {
+  i2c_stats_t stats;
+  i2c_get_stats(&stats);
+  return stats.transactions;
+}
+
+// Setup registers 8..51 go as one transaction each way, where they were
+// one per register (44) before
+static void test_config_block() {
+  twi_sim_slave_t *qt = twi_sim_add(0x1C);
+  // The chip's power-on LP_MODE and detect thresholds
+  qt->regs[8] = 2;
+  memset(&qt->regs[16], 10, 12);
+
+  cap_touch_init();
+  run_ms(400);
+  CHECK(cap_touch_reset_state() == CAP_TOUCH_RESET_READY);
+
+  // First read after the reset fills the shadow in one burst
+  cap_touch_stats_t stats;
+  cap_touch_config_t config;
+  cap_touch_read_config(&config);
+  cap_touch_get_stats(&stats);
+  CHECK(stats.config_transactions == 1);
+  CHECK(config.lp_mode == 2);
+  CHECK(config.key_detect_threshold[6] == 10);
+
+  // ...and after that it's served from the shadow
+  cap_touch_read_config(&config);
+  cap_touch_get_stats(&stats);
+  CHECK(stats.config_transactions == 0);
+
+  // Changes anywhere in the block go out together, in the background
+  config.ttd = 3;
+  config.charge_time = 1;
+  config.key_detect_threshold[6] = 20;
+  config.key_pulse_scale[0] = 0x24;
+  uint32_t writes = qt->writes;
+  uint32_t before = bus_transactions();
+  cap_touch_write_config(&config);
+  CHECK(bus_transactions() == before);
+  run_ms(5);
+  CHECK(qt->writes - writes == 1);
+  CHECK(qt->regs[9] == 3 && qt->regs[15] == 1 && qt->regs[16 + 5] == 20);
+
+  // Writing the same config again costs nothing
+  cap_touch_write_config(&config);
+  run_ms(5);
+  CHECK(qt->writes - writes == 1);
+
+  // Recalibrating doesn't wait on the bus; the command follows the change
+  config.key_detect_threshold[6] = 30;
+  cap_touch_write_config(&config);
+  qt->regs[6] = 0;
+  i2c_reset_stats();
+  cap_touch_recal();
+  i2c_stats_t bus;
+  i2c_get_stats(&bus);
+  CHECK(bus.max_block_us == 0);
+  for (uint8_t i = 0; i < 10 && qt->regs[6] == 0; ++i) {
+    run_ms(1);
+  }
+  CHECK(qt->regs[6] == 0xFF && qt->regs[16 + 5] == 30);
+  CHECK(qt->writes - writes == 3);
+  run_ms(20);
+  CHECK(cap_touch_cal_state() == CAP_TOUCH_CAL_IDLE);
+}
+
+typedef void (*test_t)();
+
+int main() {
+  static const test_t tests[] = {
+    test_write,
+    test_read,
+    test_blocking,
+    test_nack,
+    test_arbitration_lost,
+    test_queue_full_and_timeout,
+    test_blocked_caller_bounded,
+    test_config_block,
+  };
+  for (uint8_t i = 0; i < sizeof(tests) / sizeof(tests[0]); ++i) {
+    twi_sim_reset();
+    i2c_init();
+    i2c_reset_stats();
+    tests[i]();
+  }
+  return check_report("test_i2c");
+}
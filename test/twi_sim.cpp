@@ -0,0 +1,241 @@
+#include "twi_sim.h"
+
+#include <Arduino.h>
+#include <stdio.h>
+#include <util/atomic.h>
+
+#define NO_ACTION       0
+#define ACTION_START    1
+#define ACTION_BYTE     2
+
+twi_control TWCR;
+volatile uint8_t TWDR, TWSR, TWBR;
+volatile uint8_t PORTD, DDRD, PIND;
+volatile uint8_t PORTE, DDRE, PINE;
+volatile uint8_t EICRB, EIMSK, EIFR;
+
+volatile uint8_t sim_irq_off;
+
+extern "C" void TWI_vect(void);
+// Only there when the build has CAP_TOUCH_CHANGE_IRQ set
+extern "C" void INT6_vect(void) __attribute__ ((weak));
+
+static unsigned long now_us;
+static bool in_isr;
+
+static twi_sim_slave_t slaves[TWI_SIM_MAX_SLAVES];
+static uint8_t slave_count;
+static uint8_t fail_status;
+
+// Bus state, as left by the last TWCR write and bus event
+static uint8_t action;
+static bool ack;
+static bool in_transfer;
+static bool addressed;
+static bool reading;
+static bool pointer_set;
+static bool wrote;
+static twi_sim_slave_t *target;
+
+static void stop() {
+  if (target && addressed && !reading && wrote) {
+    target->writes++;
+  }
+  in_transfer = false;
+  addressed = false;
+  target = NULL;
+}
+
+// STOP goes out at once; TWINT reads back clear until the next event
+twi_control &twi_control::operator=(uint8_t v) {
+  value = v & ~((1 << TWINT) | (1 << TWSTO));
+  if (v & (1 << TWSTO)) {
+    stop();
+  }
+  if (!(v & (1 << TWEN))) {
+    stop();
+    action = NO_ACTION;
+  } else if (v & (1 << TWINT)) {
+    ack = v & (1 << TWEA);
+    if (v & (1 << TWSTA)) {
+      action = ACTION_START;
+    } else {
+      action = in_transfer ? ACTION_BYTE : NO_ACTION;
+    }
+  }
+  return *this;
+}
+
+static void drive_change() {
+  bool low = false;
+  for (uint8_t i = 0; i < slave_count; ++i) {
+    low |= slaves[i].change;
+  }
+  if (low) {
+    PINE &= ~(1 << 6);
+  } else {
+    PINE |= (1 << 6);
+  }
+}
+
+static twi_sim_slave_t *find(uint8_t addr) {
+  for (uint8_t i = 0; i < slave_count; ++i) {
+    if (slaves[i].addr == addr) {
+      return &slaves[i];
+    }
+  }
+  return NULL;
+}
+
+static bool event_due() {
+  return action != NO_ACTION && !(addressed && target && target->hang);
+}
+
+static uint8_t bus_event() {
+  if (action == ACTION_START) {
+    uint8_t status = in_transfer ? 0x10 : 0x08;
+    in_transfer = true;
+    addressed = false;
+    target = NULL;
+    return status;
+  }
+
+  if (!addressed) {
+    addressed = true;
+    reading = TWDR & 1;
+    target = find(TWDR >> 1);
+    if (!target || target->nack) {
+      target = NULL;
+      return reading ? 0x48 : 0x20;
+    }
+    if (reading) {
+      target->reads++;
+      target->reads_from[target->ptr % TWI_SIM_REG_COUNT]++;
+      if (target->ptr >= 2 && target->ptr <= 5) {
+        target->change = false;
+        drive_change();
+      }
+      return 0x40;
+    }
+    pointer_set = false;
+    wrote = false;
+    return 0x18;
+  }
+
+  if (reading) {
+    TWDR = target->regs[target->ptr % TWI_SIM_REG_COUNT];
+    target->ptr++;
+    return ack ? 0x50 : 0x58;
+  }
+  if (!pointer_set) {
+    target->ptr = TWDR;
+    pointer_set = true;
+  } else {
+    target->regs[target->ptr % TWI_SIM_REG_COUNT] = TWDR;
+    target->ptr++;
+    wrote = true;
+  }
+  return 0x28;
+}
+
+static void take_interrupt() {
+  uint8_t status;
+  if (fail_status) {
+    status = fail_status;
+    fail_status = 0;
+    stop();
+  } else {
+    status = bus_event();
+  }
+  action = NO_ACTION;
+  TWSR = status;
+  now_us += TWI_SIM_BYTE_US;
+
+  in_isr = true;
+  TWI_vect();
+  in_isr = false;
+}
+
+void sim_irq_enabled() {
+  if (!in_isr && event_due()) {
+    take_interrupt();
+  }
+}
+
+unsigned long micros() {
+  if (++now_us > TWI_SIM_TIME_LIMIT_US) {
+    printf("simulated time limit reached; stuck waiting on the bus?\n");
+    exit(2);
+  }
+  if (!sim_irq_off) {
+    sim_irq_enabled();
+  }
+  return now_us;
+}
+
+unsigned long millis() {
+  return micros() / 1000;
+}
+
+void delay(unsigned long ms) {
+  twi_sim_advance(ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us) {
+  now_us += us;
+}
+
+void twi_sim_reset() {
+  memset(slaves, 0, sizeof(slaves));
+  slave_count = 0;
+  fail_status = 0;
+  action = NO_ACTION;
+  stop();
+  TWCR.value = 0;
+  // SCL, SDA and CHANGE released
+  PIND = (1 << 0) | (1 << 1);
+  PINE = (1 << 6);
+}
+
+twi_sim_slave_t *twi_sim_add(uint8_t addr) {
+  if (slave_count >= TWI_SIM_MAX_SLAVES) {
+    return NULL;
+  }
+  twi_sim_slave_t *s = &slaves[slave_count++];
+  s->addr = addr;
+  return s;
+}
+
+void twi_sim_change(twi_sim_slave_t *slave) {
+  bool was_low = !(PINE & (1 << 6));
+  slave->change = true;
+  drive_change();
+  if (!was_low && INT6_vect && (EIMSK & (1 << INT6))) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      in_isr = true;
+      INT6_vect();
+      in_isr = false;
+    }
+  }
+}
+
+void twi_sim_fail_next(uint8_t status) {
+  fail_status = status;
+}
+
+void twi_sim_advance(unsigned long us) {
+  unsigned long until = now_us + us;
+  while ((long)(until - now_us) > 0) {
+    micros();
+  }
+}
+
+void twi_sim_run() {
+  for (uint16_t i = 0; i < 10000 && event_due(); ++i) {
+    micros();
+  }
+}
+
+unsigned long twi_sim_now() {
+  return now_us;
+}
@@ -0,0 +1,60 @@
+#ifndef TWI_SIM_H
+#define TWI_SIM_H
+
+#include <stdint.h>
+
+// Simulated TWI
+// -------------
+// Host stand-in for the ATmega32U4 TWI peripheral and the clock. Slaves
+// behave like the QT2120: the first byte written sets the register
+// pointer, then reads and writes auto-increment from it. They share a
+// CHANGE line on PE6 (wired-OR, active low): a slave holds it low from
+// twi_sim_change() until a read of its status registers (2..5).
+//
+// Time only moves when the code under test reads it, one microsecond per
+// micros() call, so busy waits make progress. Each of those calls made with
+// interrupts enabled (outside ATOMIC_BLOCK and the interrupt itself), and
+// each end of an ATOMIC_BLOCK, lets the peripheral take the next bus event
+// and call TWI_vect, a byte time later; the driver and anything blocked on
+// it run much as they do on the board.
+
+#define TWI_SIM_BYTE_US       90
+#define TWI_SIM_REG_COUNT     100
+#define TWI_SIM_MAX_SLAVES    4
+
+// A test still running after this much simulated time is stuck; it's
+// ended, as a failure
+#define TWI_SIM_TIME_LIMIT_US 600000000UL
+
+typedef struct twi_sim_slave {
+  uint8_t addr;
+  uint8_t regs[TWI_SIM_REG_COUNT];
+  uint8_t ptr;
+  bool nack;                // doesn't acknowledge its address
+  bool hang;                // once addressed, the transfer never moves on
+  bool change;              // holding CHANGE low
+  uint32_t reads;           // read transactions
+  uint32_t writes;          // write transactions that wrote data
+  uint32_t reads_from[TWI_SIM_REG_COUNT];   // ...by first register
+} twi_sim_slave_t;
+
+// Clears slaves and faults and releases the bus; the clock carries on
+void twi_sim_reset();
+twi_sim_slave_t *twi_sim_add(uint8_t addr);
+
+// The slave has something new to report: CHANGE goes low, and INT6_vect is
+// called if the sketch has it enabled
+void twi_sim_change(twi_sim_slave_t *slave);
+
+// The next bus event reports status (e.g. 0x38, arbitration lost) instead
+void twi_sim_fail_next(uint8_t status);
+
+// Moves the clock on, taking interrupts as it goes
+void twi_sim_advance(unsigned long us);
+
+// Takes bus events until the bus is idle or a slave hangs it
+void twi_sim_run();
+
+unsigned long twi_sim_now();
+
+#endif